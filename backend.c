@@ -3,26 +3,65 @@
    Features:
    - Customer lists (confirmed + waitlist)
    - Hash table for fast lookup
-   - Undo (stack) for last booking
+   - Undo/redo over a bounded ring of recent changes (bookings, cancellations,
+     modifications, route assignments, slot count changes)
    - Route graph with Dijkstra shortest path
+   - Route cost cache (per-source distance rows, rebuilt when the graph changes)
    - Route validation and cost calculation (PRICE_PER_UNIT)
-   - File persistence (confirmed.csv, waitlist.csv, meta.txt)
+   - File persistence (snapshot.bin binary snapshot + journal.bin write-ahead log,
+     confirmed.csv/waitlist.csv/meta.txt import and export)
    - Exposes backend_get_shortest_path_text()
+   - Thread-safe API (sharded reservation index, see "Locking" below)
    - Made by Piyush Gairola,Ajeet Singh Panwar,Ashish Kunal
 */
 
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "backend.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <limits.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
-#define MAX_STACK 100
-#define HASH_SIZE 101
+#define UNDO_RING_BYTES (64 * 1024) /* undo/redo history, oldest steps dropped beyond this */
+#define HASH_INITIAL_CAP 128  /* slots, power of two */
+#define HASH_MIGRATE_STEP 64  /* old slots moved per operation while growing */
+#define DIRECT_BASE 1000        /* first id handed out by next_reservation_id */
+#define DIRECT_PAGE_BITS 10     /* 1024 ids per page */
+#define DIRECT_PAGE_SIZE (1 << DIRECT_PAGE_BITS)
+#define DIRECT_MAX_PAGES (1 << 16) /* per shard: ids DIRECT_BASE .. DIRECT_BASE + 1G go direct */
+#define RES_SHARD_BITS 4           /* reservation index is split into 16 locked shards */
+#define RES_SHARDS (1 << RES_SHARD_BITS)
+#define SLAB_OBJECTS 256           /* objects per slab */
+#define ARENA_SLAB_OBJECTS 65536   /* largest slab while bulk loading */
 #define CONFIRMED_FILE "confirmed.csv"
 #define WAITLIST_FILE "waitlist.csv"
 #define META_FILE "meta.txt"
+#define SNAPSHOT_FILE "snapshot.bin"
+#define SNAPSHOT_MAGIC "URSSNAP1"
+#define SNAPSHOT_VERSION 3
+#define JOURNAL_FILE "journal.bin"
+#define JOURNAL_MAGIC "URSJRNL1"
+#define JOURNAL_BUF_MAX (64 * 1024)                   /* pending bytes that force a commit */
+#define JOURNAL_CHECKPOINT_BYTES (4L * 1024 * 1024)   /* journal size that triggers a snapshot */
+#define JOURNAL_FSYNC_BATCH 32                        /* commits per fsync under BACKEND_FSYNC_BATCH */
 
 #define PRICE_PER_UNIT 100 /* price multiplier per graph weight unit */
 
@@ -35,40 +74,326 @@ struct customer {
     int route_from;
     int route_to;
     int cost; /* distance * PRICE_PER_UNIT */
+    int group_id; /* lead reservation id of a group booking, 0 for a single booking */
+    int path_rank; /* candidate route holding the leg seats of a confirmed record, 0 = shortest */
+    unsigned long list_seq; /* stamped by list_append: increases along each list (listing cursors) */
+    atomic_int status; /* RES_CONFIRMED or RES_WAITLISTED, read without locks by backend_search */
     struct customer *next;
+    struct customer *prev;
+    struct customer *contact_next; /* lookup index: chain of the contact's bucket */
+    struct customer *contact_prev;
+    struct customer *name_left;    /* lookup index: name treap */
+    struct customer *name_right;
+    struct RoutePair *route_pair;  /* route index: entry of (route_from, route_to), NULL if not indexed */
+    struct customer *route_next;
+    struct customer *route_prev;
+    struct WaitUnit *wait_unit;    /* waitlist index: unit of a waitlisted record, NULL if not indexed */
+    struct customer *wait_next;
+    struct customer *wait_prev;
+};
+
+/* Intrusive FIFO threaded through customer next/prev */
+struct CustomerList {
+    struct customer *head;
+    struct customer *tail;
+    int count;
 };
 
-struct HashNode {
+/* record status, same values backend_search() reports */
+#define RES_CONFIRMED 1
+#define RES_WAITLISTED 2
+
+/* Open-addressing slot: custPtr == NULL is empty, HASH_TOMBSTONE is a deleted entry */
+struct HashSlot {
     int reservation_id;
     struct customer *custPtr;
-    struct HashNode *next;
+};
+
+struct HashTable {
+    struct HashSlot *slots;
+    unsigned cap;   /* power of two */
+    unsigned count; /* live entries */
+    unsigned used;  /* live entries + tombstones */
+};
+
+/* One page of a shard's direct table: rec[shard-local index - page start] */
+struct DirectPage {
+    _Atomic(struct customer *) rec[DIRECT_PAGE_SIZE];
+    int live;
+};
+
+/* Page directory of a shard. Growing publishes a new copy and retires the old
+   one, so a lock-free reader can finish with whichever copy it loaded. */
+struct DirectDir {
+    int count;
+    _Atomic(struct DirectPage *) page[];
+};
+
+/* On-disk form of a record (journal payload), fixed width so it can be written raw */
+struct DiskRecord {
+    int32_t reservation_id;
+    int32_t age;
+    int32_t slot_number;
+    int32_t route_from;
+    int32_t route_to;
+    int32_t cost;
+    int32_t status;
+    char name[50];
+    char contact[15];
+    uint8_t path_rank; /* 0 in records written before alternative routes */
+    char pad[2];
+    int32_t group_id; /* absent in version 1 records */
+};
+
+/* size of a version 1 DiskRecord, still accepted from old snapshots and journals */
+#define DISK_RECORD_V1_SIZE offsetof(struct DiskRecord, group_id)
+
+/* a capacity set through backend_set_leg_capacity, cities in ascending order */
+struct LegCap {
+    int32_t from;
+    int32_t to;
+    int32_t seats;
+};
+
+/* snapshot.bin: this header, then confirmed_count + waitlist_count DiskRecords
+   in list order (confirmed first), then (version 3 on) a uint32 count and that
+   many LegCaps */
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t generation;
+    int32_t next_reservation_id;
+    int32_t total_slots;
+    int32_t booked_slots;
+    uint32_t confirmed_count;
+    uint32_t waitlist_count;
+};
+
+/* journal record types */
+#define JREC_PUT 1   /* struct DiskRecord: insert or overwrite, moving lists if status changed */
+#define JREC_DEL 2   /* int32 reservation id */
+#define JREC_META 3  /* int32 next_reservation_id, total_slots, booked_slots */
+#define JREC_PUTS 4  /* DiskRecord[]: one JREC_PUT per element (backend_book_batch) */
+#define JREC_DELS 5  /* int32[]: one JREC_DEL per element (backend_cancel_batch) */
+#define JREC_LEGCAP 6 /* struct LegCap; from < 0 clears them all (backend_load_routes) */
+#define JREC_MAX_LEN (64u * 1024 * 1024) /* longer payloads are treated as corruption */
+
+struct JournalRecHeader {
+    uint32_t type;
+    uint32_t len;
+    uint32_t crc; /* over type + payload */
+};
+
+/* Fixed-size object pool: slabs carved into objects, freed objects kept on a
+   free list for reuse. Slabs are only returned by slab_release_all(). */
+struct Slab {
+    struct Slab *next;
+    int objects;
+};
+
+struct SlabPool {
+    size_t obj_size;
+    void *free_list;
+    struct Slab *slabs;
+    char *bump;          /* next never-used object in the newest slab */
+    int bump_left;
+    int slab_objects;    /* size of the next slab */
+    int arena;           /* bulk-load mode: slab size doubles up to ARENA_SLAB_OBJECTS */
+    long live;
+    long slab_count;
+    long capacity;       /* objects across all slabs */
 };
 
 /* Globals */
-static struct customer *confirmed_list = NULL;
-static struct customer *waitlist = NULL;
-static struct HashNode *hashTable[HASH_SIZE];
+static struct CustomerList confirmed_list;
+static struct CustomerList waitlist;
+static struct customer hash_tombstone_mark;
+#define HASH_TOMBSTONE (&hash_tombstone_mark)
+
+/* One stripe of the reservation index: the records whose id & (RES_SHARDS - 1)
+   is the shard number, in their own direct table and hash table */
+struct ResShard {
+    pthread_rwlock_t lock;
+    struct HashTable table;     /* receives all inserts */
+    struct HashTable old;       /* table being drained after a resize */
+    unsigned migrate_pos;
+    _Atomic(struct DirectDir *) dir; /* NULL page = not allocated */
+};
+
+static struct ResShard res_shards[RES_SHARDS];
+static int res_shards_ready = 0;
+
+/* Locking. A shard's lock covers only its id tables. state_lock covers the
+   records themselves: both lists (including the next/prev links), every record
+   field, the slot counters, the secondary indexes, the undo history and
+   customer_pool. journal_lock covers the pending journal buffer. They nest in
+   that order: one shard (or several, in index order), then state, then journal,
+   so a booking finds or indexes its id before it queues for state_lock and
+   promotion never needs a shard lock. retire_lock covers the retire list and
+   nests under either. route_lock guards the graph, route_csr and edge_pool;
+   route_cache_lock guards the cache under it. backend_search and
+   backend_get_availability_text take no lock at all: see EPOCH RECLAMATION and
+   slots_publish(). */
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t retire_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t route_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t route_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct SlabPool customer_pool;
+static struct SlabPool edge_pool;
+
+/* Write-ahead log: mutations are queued in buf and appended by journal_commit() */
+static struct {
+    FILE *f;
+    unsigned generation; /* must match meta.txt for the journal to be replayed */
+    long size;           /* bytes in the journal file */
+    unsigned char *buf;
+    size_t len;
+    size_t cap;
+    int fsync_policy;
+    int commits_since_sync;
+    int clean;       /* nothing appended since the last checkpoint: snapshot.bin is current */
+    int meta_valid;
+    int32_t meta[3]; /* last META appended, so an unchanged one is not written again */
+} journal = { NULL, 0, 0, NULL, 0, 0, BACKEND_FSYNC_BATCH, 0, 0, 0, { 0, 0, 0 } };
+
+/* Work handed to the background writer, processed strictly in queue order */
+#define PJOB_JOURNAL 1  /* append data to journal.bin */
+#define PJOB_SNAPSHOT 2 /* data is a full snapshot.bin image; then start a fresh journal */
+#define PJOB_SYNC 3     /* fsync journal.bin (backend_flush barrier) */
+
+struct PersistJob {
+    int kind;
+    int fsync_policy;
+    unsigned generation;
+    unsigned char *data;
+    size_t len;
+    struct PersistJob *next;
+};
+
+/* Asynchronous persistence: the writer thread owns journal.f while running */
+static struct {
+    int running;
+    int stop;
+    int busy;
+    int failed;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake; /* job queued or stop requested */
+    pthread_cond_t idle; /* queue drained */
+    struct PersistJob *head;
+    struct PersistJob *tail;
+} persist = { 0, 0, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL };
+
+static void journal_append(uint32_t type, const void *payload, uint32_t len);
+static void journal_append_array(uint32_t type, const void *items, size_t count, size_t item_size);
+static void journal_put(const struct customer *c);
+static void journal_del(int reservation_id);
+static void journal_meta();
+static void to_disk_record(const struct customer *c, struct DiskRecord *r);
+struct LegPath;
+static const struct LegPath *leg_path(int from, int to, int rank);
+static int leg_choose(int from, int to, int k, const struct LegPath **out);
+static void legs_take(const struct LegPath *p, int k);
+static int legs_price(const struct LegPath *p, int cost);
+static int promote_waitlist_local();
+static void wait_index_add(struct customer *c);
+static void wait_index_remove(struct customer *c);
+static void wait_index_reset();
+static void wait_wake_path(const struct LegPath *p);
+static void wait_wake_leg(int leg);
 
 static int total_slots = 5;
 static int booked_slots = 0;
-static int next_reservation_id = 1000;
+/* A waitlisted booking fits its legs but waits for free slots; see promote_waitlist_local() */
+static int waitlist_blocked = 0;
 
-static struct customer undo_stack[MAX_STACK];
-static int top = -1;
+/* Copy of the slot counters for lock-free readers, republished under state_lock.
+   seq is odd while an update is in progress (seqlock). */
+static struct {
+    atomic_uint seq;
+    atomic_int total;
+    atomic_int booked;
+} slots_pub;
+static atomic_int next_reservation_id = 1000;
 
 /* Graph */
 struct Edge {
     int to;
     int weight;
+    int leg; /* shared by both directions of an undirected edge */
     struct Edge *next;
 };
 
 struct Graph {
     int n;
+    int legs; /* undirected edges, numbered 0..legs-1 */
     struct Edge **adj;
 };
 
 static struct Graph *route_graph = NULL;
+static unsigned route_graph_version = 1;
+
+/* Compact (CSR) copy of route_graph used by Dijkstra */
+struct RouteCSR {
+    int n;
+    int m;
+    int *offset; /* n+1 entries */
+    int *target;
+    int *weight;
+    int *leg;
+    unsigned version;
+};
+
+static struct RouteCSR route_csr;
+
+/* Per-thread Dijkstra buffers, grown on demand and reused across calls */
+struct HeapEntry {
+    int key;
+    int node;
+};
+
+/* Everything Dijkstra tracks per node, kept together so a relaxation touches one cache line */
+struct NodeState {
+    int dist;
+    int prev;
+    int pos;        /* heap slot, -1 = not in heap, -2 = settled */
+    unsigned stamp; /* state is valid only when stamp == cur_stamp */
+};
+
+struct DijkstraScratch {
+    int cap;
+    struct NodeState *node;
+    struct HeapEntry *heap;
+    int heap_len;
+    unsigned cur_stamp;
+};
+
+static _Thread_local struct DijkstraScratch dj_scratch;
+
+/* Distance rows keyed by source city, see route_cache_row() */
+#define ROUTE_CACHE_MAX_ROWS 1024
+#define ROUTE_CACHE_MAX_CELLS (4L * 1024 * 1024) /* ints across all rows */
+#define ROUTE_CACHE_EAGER_MAX 64                 /* graphs this small are fully built at init */
+
+struct RouteCacheRow {
+    int src;
+    int *dist; /* dist[v], -1 if unreachable */
+};
+
+static struct {
+    int n;
+    int *row_of; /* source city -> row index, -1 if not cached */
+    struct RouteCacheRow rows[ROUTE_CACHE_MAX_ROWS];
+    int used;
+    int max_rows;
+    int next_victim;
+    unsigned version;
+    unsigned long hits;
+    unsigned long misses;
+} route_cache;
 
 /* City names array (demo) */
 static const char *CityName[] = {
@@ -76,445 +401,4110 @@ static const char *CityName[] = {
 };
 static const int CITY_COUNT = 6;
 
+/* Name of city, "City n" past the demo names (loaded graphs) or "N/A" below 0;
+   tmp holds the numbered form. Takes no lock: callers check the upper bound. */
+static const char *city_name_local(int city, char *tmp, int size) {
+    if (city < 0) return "N/A";
+    if (city < CITY_COUNT) return CityName[city];
+    snprintf(tmp, size, "City %d", city);
+    return tmp;
+}
+
+/* ----------------- STATS ----------------- */
+/* Hot-path counters and latency histograms. Updates are relaxed atomic adds,
+   so they never take a lock; building with -DBACKEND_NO_STATS removes them. */
+#ifndef BACKEND_NO_STATS
+#define STATS_COUNTERS(X) \
+    X(bookings) X(bookings_waitlisted) X(booking_failures) \
+    X(cancels) X(cancel_misses) X(promotions) \
+    X(lookups_direct) X(lookups_hash) X(hash_probes) \
+    X(dijkstra_runs) X(dijkstra_settled) \
+    X(journal_bytes) X(snapshot_bytes) X(commits) X(checkpoints) \
+    X(slab_allocs) X(slab_frees) X(slabs_created)
+#define STATS_HISTOGRAMS(X) X(book_ns) X(cancel_ns) X(probe_len)
+
+#define STATS_FIELD(name) atomic_ulong name;
+#define STATS_HIST_FIELD(name) atomic_ulong name[BACKEND_STATS_BUCKETS];
+static struct {
+    STATS_COUNTERS(STATS_FIELD)
+    STATS_HISTOGRAMS(STATS_HIST_FIELD)
+} stats;
+
+static unsigned long stats_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000UL + (unsigned long)ts.tv_nsec;
+}
+
+/* bucket i holds 2^i <= v < 2^(i+1); 0 goes to bucket 0 */
+static int stats_bucket(unsigned long v) {
+    int b = v ? 63 - __builtin_clzl(v) : 0;
+    return b < BACKEND_STATS_BUCKETS ? b : BACKEND_STATS_BUCKETS - 1;
+}
+
+#define STAT_ADD(name, n) atomic_fetch_add_explicit(&stats.name, (unsigned long)(n), memory_order_relaxed)
+#define STAT_HIST(name, v) atomic_fetch_add_explicit(&stats.name[stats_bucket(v)], 1, memory_order_relaxed)
+#define STAT_TIMER(t) unsigned long t = stats_now()
+#define STAT_ELAPSED(name, t) STAT_HIST(name, stats_now() - (t))
+#else
+#define STAT_ADD(name, n) ((void)(n))
+#define STAT_HIST(name, v) ((void)0)
+#define STAT_TIMER(t) ((void)0)
+#define STAT_ELAPSED(name, t) ((void)0)
+#endif
+
 /* ----------------- UNDO ----------------- */
-static void push_undo_local(struct customer c) {
-    if (top >= MAX_STACK - 1) {
-        /* ignore if full */
-    } else {
-        undo_stack[++top] = c;
+/* Undo history: one small delta per book, cancel, modify, assign-route, slot
+   count or leg capacity change, packed into a ring of UNDO_RING_BYTES. An entry is its size, its
+   type, the fields it needs (strings carry a length byte) and its size again, so
+   the ring can be walked one step back (undo) or forward (redo) in O(1). A new
+   entry drops the redo tail and, once the ring is full, the oldest entries.
+   Booked and cancelled records are kept by value since the record itself may be
+   gone. Runs under state_lock; see UNDO REPLAY for applying entries. */
+#define UNDO_ENTRY_MAX 256
+
+enum { UNDO_BOOK = 1, UNDO_CANCEL, UNDO_MODIFY, UNDO_ROUTE, UNDO_SLOTS, UNDO_LEGCAP };
+
+static struct {
+    unsigned char ring[UNDO_RING_BYTES];
+    unsigned long tail;   /* oldest entry; positions grow forever, ring index = pos % size */
+    unsigned long cursor; /* entries before it can be undone, entries after it redone */
+    unsigned long end;
+} undo;
+
+/* An entry being built or read back */
+struct UndoEntry {
+    unsigned char b[UNDO_ENTRY_MAX];
+    int len;
+};
+
+static void undo_copy_in(unsigned long pos, const void *src, int len) {
+    int at = (int)(pos % UNDO_RING_BYTES), first = UNDO_RING_BYTES - at;
+    if (first > len) first = len;
+    memcpy(undo.ring + at, src, first);
+    memcpy(undo.ring, (const unsigned char *)src + first, len - first);
+}
+
+static void undo_copy_out(unsigned long pos, void *dst, int len) {
+    int at = (int)(pos % UNDO_RING_BYTES), first = UNDO_RING_BYTES - at;
+    if (first > len) first = len;
+    memcpy(dst, undo.ring + at, first);
+    memcpy((unsigned char *)dst + first, undo.ring, len - first);
+}
+
+static int undo_size_at(unsigned long pos) {
+    uint16_t size;
+    undo_copy_out(pos, &size, sizeof(size));
+    return size;
+}
+
+static void undo_begin(struct UndoEntry *e, int type) {
+    e->len = sizeof(uint16_t);
+    e->b[e->len++] = (unsigned char)type;
+}
+
+static void undo_put_int(struct UndoEntry *e, int v) {
+    int32_t x = v;
+    memcpy(e->b + e->len, &x, sizeof(x));
+    e->len += sizeof(x);
+}
+
+/* s is a record field of at most max bytes, not always terminated */
+static void undo_put_str(struct UndoEntry *e, const char *s, int max) {
+    int n = 0;
+    while (n < max - 1 && s[n]) n++;
+    e->b[e->len++] = (unsigned char)n;
+    memcpy(e->b + e->len, s, n);
+    e->len += n;
+}
+
+static int undo_get_int(const unsigned char **p) {
+    int32_t x;
+    memcpy(&x, *p, sizeof(x));
+    *p += sizeof(x);
+    return x;
+}
+
+static void undo_get_str(const unsigned char **p, char *dst) {
+    int n = *(*p)++;
+    memcpy(dst, *p, n);
+    dst[n] = '\0';
+    *p += n;
+}
+
+/* Seals e with its size at both ends and appends it */
+static void undo_push(struct UndoEntry *e) {
+    uint16_t size = (uint16_t)(e->len + sizeof(uint16_t));
+    memcpy(e->b, &size, sizeof(size));
+    memcpy(e->b + e->len, &size, sizeof(size));
+    undo.end = undo.cursor;
+    while (undo.end + size - undo.tail > UNDO_RING_BYTES) undo.tail += undo_size_at(undo.tail);
+    undo_copy_in(undo.end, e->b, size);
+    undo.cursor = undo.end += size;
+}
+
+static void undo_reset() {
+    undo.tail = undo.cursor = undo.end = 0;
+}
+
+/* UNDO_BOOK (c was just booked) or UNDO_CANCEL (c is about to go) */
+static void undo_record(int type, const struct customer *c) {
+    struct UndoEntry e;
+    undo_begin(&e, type);
+    undo_put_int(&e, c->reservation_id);
+    undo_put_int(&e, c->age);
+    undo_put_int(&e, c->slot_number);
+    undo_put_int(&e, c->route_from);
+    undo_put_int(&e, c->route_to);
+    undo_put_int(&e, c->cost);
+    undo_put_int(&e, c->group_id);
+    undo_put_str(&e, c->name, sizeof(c->name));
+    undo_put_str(&e, c->contact, sizeof(c->contact));
+    undo_push(&e);
+}
+
+static void undo_get_record(const unsigned char **p, struct customer *c) {
+    c->reservation_id = undo_get_int(p);
+    c->age = undo_get_int(p);
+    c->slot_number = undo_get_int(p);
+    c->route_from = undo_get_int(p);
+    c->route_to = undo_get_int(p);
+    c->cost = undo_get_int(p);
+    c->group_id = undo_get_int(p);
+    undo_get_str(p, c->name);
+    undo_get_str(p, c->contact);
+}
+
+/* Old and new values of the fields backend_modify changed (NULL = left alone) */
+static void undo_record_modify(const struct customer *was, const char *name, int age, const char *contact) {
+    struct UndoEntry e;
+    undo_begin(&e, UNDO_MODIFY);
+    undo_put_int(&e, was->reservation_id);
+    undo_put_int(&e, was->age);
+    undo_put_int(&e, age > 0 ? age : was->age);
+    e.b[e.len++] = (unsigned char)((name ? 1 : 0) | (contact ? 2 : 0));
+    if (name) {
+        undo_put_str(&e, was->name, sizeof(was->name));
+        undo_put_str(&e, name, sizeof(was->name));
+    }
+    if (contact) {
+        undo_put_str(&e, was->contact, sizeof(was->contact));
+        undo_put_str(&e, contact, sizeof(was->contact));
+    }
+    undo_push(&e);
+}
+
+static void undo_record_route(const struct customer *was, int from, int to, int cost) {
+    struct UndoEntry e;
+    undo_begin(&e, UNDO_ROUTE);
+    undo_put_int(&e, was->reservation_id);
+    undo_put_int(&e, was->route_from);
+    undo_put_int(&e, was->route_to);
+    undo_put_int(&e, was->cost);
+    undo_put_int(&e, from);
+    undo_put_int(&e, to);
+    undo_put_int(&e, cost);
+    undo_push(&e);
+}
+
+static void undo_record_slots(int old_n, int n) {
+    struct UndoEntry e;
+    undo_begin(&e, UNDO_SLOTS);
+    undo_put_int(&e, old_n);
+    undo_put_int(&e, n);
+    undo_push(&e);
+}
+
+static void undo_record_legcap(int from, int to, int old_seats, int seats) {
+    struct UndoEntry e;
+    undo_begin(&e, UNDO_LEGCAP);
+    undo_put_int(&e, from);
+    undo_put_int(&e, to);
+    undo_put_int(&e, old_seats);
+    undo_put_int(&e, seats);
+    undo_push(&e);
+}
+
+/* ----------------- EPOCH RECLAMATION ----------------- */
+/* backend_search walks the direct index and reads a record's status without
+   taking any lock. Memory such a reader may still hold (deleted records, emptied
+   index pages, replaced page directories) is retired instead of freed, and
+   released once every reader active at the time has left: a retired object is
+   safe two global epochs later. Index pages are retired under a shard lock and
+   records under state_lock; only a pass started under state_lock hands records
+   back to customer_pool. */
+#define EPOCH_READERS 64        /* threads reading at once; beyond that searches lock */
+#define EPOCH_RECLAIM_EVERY 64  /* retirements between reclaim passes */
+
+#define RETIRE_FREE 1    /* release with free() */
+#define RETIRE_RECORD 2  /* release with slab_free() into customer_pool */
+
+struct EpochReader {
+    atomic_uint epoch; /* global epoch seen on entry, 0 = not reading */
+    atomic_int taken;
+    char pad[56];      /* one reader per cache line */
+};
+
+struct Retired {
+    void *ptr;
+    int kind;
+    unsigned epoch;
+};
+
+static atomic_uint global_epoch = 1;
+static struct EpochReader epoch_readers[EPOCH_READERS];
+static pthread_key_t epoch_key;
+static pthread_once_t epoch_once = PTHREAD_ONCE_INIT;
+static _Thread_local struct EpochReader *epoch_self;
+
+static struct {
+    struct Retired *items;
+    int len;
+    int cap;
+    int since_reclaim;
+} retired;
+
+static void slab_free(struct SlabPool *p, void *obj);
+
+static void epoch_release_reader(void *arg) {
+    atomic_store(&((struct EpochReader *)arg)->taken, 0);
+}
+
+static void epoch_key_init() {
+    pthread_key_create(&epoch_key, epoch_release_reader);
+}
+
+/* This thread's reader slot, claimed on first use and given back when the
+   thread exits. NULL if all EPOCH_READERS slots are taken. */
+static struct EpochReader *epoch_reader() {
+    if (epoch_self) return epoch_self;
+    pthread_once(&epoch_once, epoch_key_init);
+    for (int i = 0; i < EPOCH_READERS; i++) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&epoch_readers[i].taken, &expected, 1)) {
+            epoch_self = &epoch_readers[i];
+            pthread_setspecific(epoch_key, epoch_self);
+            return epoch_self;
+        }
+    }
+    return NULL;
+}
+
+static void epoch_enter(struct EpochReader *r) {
+    atomic_store_explicit(&r->epoch, atomic_load_explicit(&global_epoch, memory_order_relaxed), memory_order_relaxed);
+    /* pairs with the fence in epoch_reclaim(): either the reclaimer sees this
+       reader, or this reader sees every unlink made before the scan */
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+static void epoch_exit(struct EpochReader *r) {
+    atomic_store_explicit(&r->epoch, 0, memory_order_release);
+}
+
+static void epoch_release(struct Retired *it) {
+    if (it->kind == RETIRE_RECORD) slab_free(&customer_pool, it->ptr);
+    else free(it->ptr);
+}
+
+/* Advances the global epoch if no reader is behind it, then releases what
+   was retired at least two epochs ago; records only if records is set (the
+   caller holds state_lock). Caller holds retire_lock. */
+static void epoch_reclaim(int records) {
+    unsigned e = atomic_load(&global_epoch);
+    atomic_thread_fence(memory_order_seq_cst);
+    int behind = 0;
+    for (int i = 0; i < EPOCH_READERS && !behind; i++) {
+        unsigned re = atomic_load_explicit(&epoch_readers[i].epoch, memory_order_relaxed);
+        behind = re != 0 && re != e;
+    }
+    if (!behind) atomic_store(&global_epoch, ++e);
+    int kept = 0;
+    for (int i = 0; i < retired.len; i++) {
+        if (retired.items[i].epoch + 2 <= e && (records || retired.items[i].kind != RETIRE_RECORD)) epoch_release(&retired.items[i]);
+        else retired.items[kept++] = retired.items[i];
+    }
+    retired.len = kept;
+}
+
+/* RETIRE_RECORD only under state_lock */
+static void epoch_retire(void *ptr, int kind) {
+    if (!ptr) return;
+    pthread_mutex_lock(&retire_lock);
+    if (retired.len == retired.cap) {
+        int cap = retired.cap ? retired.cap * 2 : 256;
+        struct Retired *items = realloc(retired.items, sizeof(struct Retired) * cap);
+        if (!items) { /* out of memory: leaking is the only safe choice */
+            pthread_mutex_unlock(&retire_lock);
+            return;
+        }
+        retired.items = items;
+        retired.cap = cap;
+    }
+    struct Retired *it = &retired.items[retired.len++];
+    it->ptr = ptr;
+    it->kind = kind;
+    it->epoch = atomic_load(&global_epoch);
+    if (++retired.since_reclaim >= EPOCH_RECLAIM_EVERY) {
+        retired.since_reclaim = 0;
+        epoch_reclaim(kind == RETIRE_RECORD);
+    }
+    pthread_mutex_unlock(&retire_lock);
+}
+
+/* Drops the retire list when no reader can exist (backend_shutdown); records
+   go away with customer_pool itself */
+static void epoch_reset() {
+    for (int i = 0; i < retired.len; i++) {
+        if (retired.items[i].kind == RETIRE_FREE) free(retired.items[i].ptr);
+    }
+    retired.len = 0;
+    retired.since_reclaim = 0;
+}
+
+/* ----------------- HASH ----------------- */
+/* Linear probing over a power-of-two table. Growing allocates a new table and
+   drains the old one HASH_MIGRATE_STEP slots per insert/delete, so no single
+   booking pays for a full rehash. Lookups check both tables until the drain ends.
+   Every function here works on one shard and expects its lock to be held. */
+static unsigned hashFunction(int reservation_id) {
+    unsigned h = (unsigned)reservation_id;
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return h;
+}
+
+static int hash_table_alloc(struct HashTable *t, unsigned cap) {
+    t->slots = calloc(cap, sizeof(struct HashSlot));
+    if (!t->slots) return -1;
+    t->cap = cap;
+    t->count = 0;
+    t->used = 0;
+    return 0;
+}
+
+static void hash_table_free(struct HashTable *t) {
+    free(t->slots);
+    t->slots = NULL;
+    t->cap = t->count = t->used = 0;
+}
+
+/* Returns the slot holding reservation_id, or NULL. Adds the number of slots
+   inspected to *probes if given. */
+static struct HashSlot *hash_table_find(struct HashTable *t, int reservation_id, unsigned *probes) {
+    if (!t->slots) return NULL;
+    unsigned mask = t->cap - 1;
+    unsigned i = hashFunction(reservation_id) & mask;
+    for (unsigned n = 1;; n++) {
+        struct HashSlot *s = &t->slots[i];
+        if (!s->custPtr || (s->custPtr != HASH_TOMBSTONE && s->reservation_id == reservation_id)) {
+            if (probes) *probes += n;
+            return s->custPtr ? s : NULL;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+/* Caller guarantees reservation_id is absent and the table has a free slot */
+static void hash_table_put(struct HashTable *t, int reservation_id, struct customer *p) {
+    unsigned mask = t->cap - 1;
+    unsigned i = hashFunction(reservation_id) & mask;
+    while (t->slots[i].custPtr && t->slots[i].custPtr != HASH_TOMBSTONE) i = (i + 1) & mask;
+    if (!t->slots[i].custPtr) t->used++;
+    t->slots[i].reservation_id = reservation_id;
+    t->slots[i].custPtr = p;
+    t->count++;
+}
+
+static void hash_table_remove(struct HashTable *t, struct HashSlot *s) {
+    s->custPtr = HASH_TOMBSTONE;
+    t->count--;
+}
+
+/* Moves up to `steps` live entries from the old table into the current one */
+static void hash_migrate(struct ResShard *sh, unsigned steps) {
+    if (!sh->old.slots) return;
+    while (steps > 0 && sh->migrate_pos < sh->old.cap) {
+        struct HashSlot *s = &sh->old.slots[sh->migrate_pos++];
+        if (s->custPtr && s->custPtr != HASH_TOMBSTONE) {
+            hash_table_put(&sh->table, s->reservation_id, s->custPtr);
+            hash_table_remove(&sh->old, s);
+            steps--;
+        }
+    }
+    if (sh->migrate_pos >= sh->old.cap) {
+        hash_table_free(&sh->old);
+        sh->migrate_pos = 0;
+    }
+}
+
+/* Starts a resize once live entries + tombstones pass 3/4 of the table. The new
+   table is sized for the live entries, so a tombstone-heavy table is cleaned
+   without growing. */
+static int hash_maybe_grow(struct ResShard *sh) {
+    if ((sh->table.used + 1) * 4 <= sh->table.cap * 3) return 0;
+    /* a previous drain must finish first; it is always far along by now */
+    hash_migrate(sh, UINT_MAX);
+    unsigned live = sh->table.count + 1;
+    unsigned cap = HASH_INITIAL_CAP;
+    while (cap < live * 4) cap *= 2;
+    struct HashTable fresh;
+    if (hash_table_alloc(&fresh, cap) != 0) return -1;
+    sh->old = sh->table;
+    sh->table = fresh;
+    sh->migrate_pos = 0;
+    return 0;
+}
+
+static void init_hash_table(struct ResShard *sh) {
+    hash_table_free(&sh->old);
+    hash_table_free(&sh->table);
+    sh->migrate_pos = 0;
+    hash_table_alloc(&sh->table, HASH_INITIAL_CAP);
+}
+
+static void hash_insert_record(struct ResShard *sh, struct customer *p) {
+    if (!p || !sh->table.slots) return;
+    hash_migrate(sh, HASH_MIGRATE_STEP);
+    struct HashSlot *s = hash_table_find(&sh->table, p->reservation_id, NULL);
+    if (s) { s->custPtr = p; return; }
+    s = hash_table_find(&sh->old, p->reservation_id, NULL);
+    if (s) hash_table_remove(&sh->old, s);
+    if (hash_maybe_grow(sh) != 0 && sh->table.used + 1 >= sh->table.cap) return;
+    hash_table_put(&sh->table, p->reservation_id, p);
+}
+
+static struct customer* hash_search_record(struct ResShard *sh, int reservation_id) {
+    unsigned probes = 0;
+    struct HashSlot *s = hash_table_find(&sh->table, reservation_id, &probes);
+    if (!s) s = hash_table_find(&sh->old, reservation_id, &probes);
+    STAT_ADD(lookups_hash, 1);
+    STAT_ADD(hash_probes, probes);
+    STAT_HIST(probe_len, probes);
+    return s ? s->custPtr : NULL;
+}
+
+static void hash_delete_record(struct ResShard *sh, int reservation_id) {
+    hash_migrate(sh, HASH_MIGRATE_STEP);
+    struct HashSlot *s = hash_table_find(&sh->table, reservation_id, NULL);
+    if (s) { hash_table_remove(&sh->table, s); return; }
+    s = hash_table_find(&sh->old, reservation_id, NULL);
+    if (s) hash_table_remove(&sh->old, s);
+}
+
+/* ----------------- RESERVATION INDEX ----------------- */
+/* Records are striped over RES_SHARDS shards by the low bits of the id, so
+   concurrent lookups and updates of different reservations rarely share a lock.
+   Ids from next_reservation_id are dense, so within a shard most records live in
+   a paged table indexed by (id - DIRECT_BASE) >> RES_SHARD_BITS. Pages are
+   allocated on first use and freed once every record on them is gone. Ids
+   outside that range (imported files) go to the shard's hash table. Both
+   confirmed and waitlisted records are indexed. The caller holds the shard lock:
+   shared for searchRecord, exclusive for insertRecord/deleteRecord. A record is
+   indexed once it is on its list and taken out before it is retired. */
+static struct ResShard *shard_of(int reservation_id) {
+    return &res_shards[(unsigned)reservation_id & (RES_SHARDS - 1)];
+}
+
+static int direct_slot(int reservation_id, int *page, int *off) {
+    if (reservation_id < DIRECT_BASE) return 0;
+    long rel = ((long)reservation_id - DIRECT_BASE) >> RES_SHARD_BITS;
+    if (rel >= (long)DIRECT_MAX_PAGES * DIRECT_PAGE_SIZE) return 0;
+    *page = (int)(rel >> DIRECT_PAGE_BITS);
+    *off = (int)(rel & (DIRECT_PAGE_SIZE - 1));
+    return 1;
+}
+
+/* Safe without the shard lock when create == 0 (inside an epoch section) */
+static struct DirectPage *direct_page_get(struct ResShard *sh, int page, int create) {
+    struct DirectDir *dir = atomic_load_explicit(&sh->dir, memory_order_acquire);
+    struct DirectPage *pg = (dir && page < dir->count) ? atomic_load_explicit(&dir->page[page], memory_order_acquire) : NULL;
+    if (pg || !create) return pg;
+    if (!dir || page >= dir->count) {
+        int old = dir ? dir->count : 0;
+        int cnt = old ? old : 16;
+        while (cnt <= page) cnt *= 2;
+        struct DirectDir *grown = malloc(sizeof(struct DirectDir) + sizeof(grown->page[0]) * cnt);
+        if (!grown) return NULL;
+        grown->count = cnt;
+        for (int i = 0; i < cnt; i++) {
+            atomic_init(&grown->page[i], i < old ? atomic_load_explicit(&dir->page[i], memory_order_relaxed) : NULL);
+        }
+        atomic_store_explicit(&sh->dir, grown, memory_order_release);
+        epoch_retire(dir, RETIRE_FREE);
+        dir = grown;
+    }
+    pg = calloc(1, sizeof(struct DirectPage));
+    if (pg) atomic_store_explicit(&dir->page[page], pg, memory_order_release);
+    return pg;
+}
+
+static void init_direct_index(struct ResShard *sh) {
+    struct DirectDir *dir = atomic_load(&sh->dir);
+    if (!dir) return;
+    for (int i = 0; i < dir->count; i++) free(atomic_load(&dir->page[i]));
+    free(dir);
+    atomic_store(&sh->dir, NULL);
+}
+
+/* Empties every shard; not safe against concurrent callers (see backend_shutdown) */
+static void init_res_index() {
+    for (int i = 0; i < RES_SHARDS; i++) {
+        struct ResShard *sh = &res_shards[i];
+        if (!res_shards_ready) pthread_rwlock_init(&sh->lock, NULL);
+        init_hash_table(sh);
+        init_direct_index(sh);
+    }
+    res_shards_ready = 1;
+}
+
+static void insertRecord(struct customer *p) {
+    if (!p) return;
+    struct ResShard *sh = shard_of(p->reservation_id);
+    int page, off;
+    if (!direct_slot(p->reservation_id, &page, &off)) {
+        hash_insert_record(sh, p);
+        return;
+    }
+    struct DirectPage *pg = direct_page_get(sh, page, 1);
+    if (!pg) return;
+    if (!atomic_load_explicit(&pg->rec[off], memory_order_relaxed)) pg->live++;
+    atomic_store_explicit(&pg->rec[off], p, memory_order_release);
+}
+
+static struct customer* searchRecord(int reservation_id) {
+    struct ResShard *sh = shard_of(reservation_id);
+    int page, off;
+    if (!direct_slot(reservation_id, &page, &off)) return hash_search_record(sh, reservation_id);
+    STAT_ADD(lookups_direct, 1);
+    struct DirectPage *pg = direct_page_get(sh, page, 0);
+    return pg ? atomic_load_explicit(&pg->rec[off], memory_order_acquire) : NULL;
+}
+
+static void deleteRecord(int reservation_id) {
+    struct ResShard *sh = shard_of(reservation_id);
+    int page, off;
+    if (!direct_slot(reservation_id, &page, &off)) {
+        hash_delete_record(sh, reservation_id);
+        return;
+    }
+    struct DirectPage *pg = direct_page_get(sh, page, 0);
+    if (!pg || !atomic_load_explicit(&pg->rec[off], memory_order_relaxed)) return;
+    atomic_store_explicit(&pg->rec[off], NULL, memory_order_release);
+    if (--pg->live == 0) {
+        atomic_store_explicit(&atomic_load(&sh->dir)->page[page], NULL, memory_order_release);
+        epoch_retire(pg, RETIRE_FREE);
+    }
+}
+
+/* Holds every shard shared and state_lock, so the lists, all record fields and
+   the index agree and can be walked without anything changing underneath */
+static void records_read_lock() {
+    for (int i = 0; i < RES_SHARDS; i++) pthread_rwlock_rdlock(&res_shards[i].lock);
+    pthread_mutex_lock(&state_lock);
+}
+
+static void records_read_unlock() {
+    pthread_mutex_unlock(&state_lock);
+    for (int i = RES_SHARDS - 1; i >= 0; i--) pthread_rwlock_unlock(&res_shards[i].lock);
+}
+
+/* Bit i of the mask stands for res_shards[i] */
+#define SHARDS_ALL ((1u << RES_SHARDS) - 1)
+
+static unsigned shard_bit(int reservation_id) {
+    return 1u << ((unsigned)reservation_id & (RES_SHARDS - 1));
+}
+
+/* Takes the shards in mask exclusively, in index order, before state_lock */
+static void shards_lock(unsigned mask) {
+    for (int i = 0; i < RES_SHARDS; i++) {
+        if (mask & (1u << i)) pthread_rwlock_wrlock(&res_shards[i].lock);
+    }
+}
+
+static void shards_unlock(unsigned mask) {
+    for (int i = RES_SHARDS - 1; i >= 0; i--) {
+        if (mask & (1u << i)) pthread_rwlock_unlock(&res_shards[i].lock);
+    }
+}
+
+/* ----------------- SLAB ALLOCATOR ----------------- */
+#define SLAB_ALIGN 16
+#define SLAB_ROUND(n) (((n) + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1))
+
+static void *slab_alloc(struct SlabPool *p) {
+    void *obj = p->free_list;
+    STAT_ADD(slab_allocs, 1);
+    if (obj) {
+        p->free_list = *(void **)obj;
+        p->live++;
+        return obj;
+    }
+    if (p->bump_left == 0) {
+        int objects = p->slab_objects ? p->slab_objects : SLAB_OBJECTS;
+        struct Slab *s = malloc(SLAB_ROUND(sizeof(struct Slab)) + (size_t)objects * p->obj_size);
+        if (!s) return NULL;
+        s->objects = objects;
+        s->next = p->slabs;
+        p->slabs = s;
+        p->slab_count++;
+        STAT_ADD(slabs_created, 1);
+        p->capacity += objects;
+        p->bump = (char *)s + SLAB_ROUND(sizeof(struct Slab));
+        p->bump_left = objects;
+        if (p->arena && p->slab_objects < ARENA_SLAB_OBJECTS) p->slab_objects *= 2;
+    }
+    obj = p->bump;
+    p->bump += p->obj_size;
+    p->bump_left--;
+    p->live++;
+    return obj;
+}
+
+static void slab_free(struct SlabPool *p, void *obj) {
+    if (!obj) return;
+    STAT_ADD(slab_frees, 1);
+    *(void **)obj = p->free_list;
+    p->free_list = obj;
+    p->live--;
+}
+
+/* Drops every slab of the pool at once; all objects from it become invalid */
+static void slab_release_all(struct SlabPool *p) {
+    struct Slab *s = p->slabs;
+    while (s) {
+        struct Slab *nx = s->next;
+        free(s);
+        s = nx;
+    }
+    p->slabs = NULL;
+    p->free_list = NULL;
+    p->bump = NULL;
+    p->bump_left = 0;
+    p->live = 0;
+    p->slab_count = 0;
+    p->capacity = 0;
+}
+
+static void slab_init(struct SlabPool *p, size_t obj_size) {
+    slab_release_all(p);
+    p->obj_size = SLAB_ROUND(obj_size);
+    p->slab_objects = SLAB_OBJECTS;
+}
+
+/* Arena mode: bulk loads carve objects from geometrically growing slabs, so a
+   large file needs few allocations; they are released with the rest of the pool */
+static void slab_arena_begin(struct SlabPool *p) { p->arena = 1; }
+static void slab_arena_end(struct SlabPool *p) { p->arena = 0; p->slab_objects = SLAB_OBJECTS; }
+
+void backend_get_alloc_stats(struct backend_alloc_stats *out) {
+    if (!out) return;
+    const struct SlabPool *pools[] = { &customer_pool, &edge_pool };
+    memset(out, 0, sizeof(*out));
+    pthread_mutex_lock(&state_lock);
+    pthread_rwlock_rdlock(&route_lock);
+    for (int i = 0; i < 2; i++) {
+        const struct SlabPool *p = pools[i];
+        out->live_objects += p->live;
+        out->slabs += p->slab_count;
+        out->bytes_reserved += (long)(p->capacity * p->obj_size + p->slab_count * SLAB_ROUND(sizeof(struct Slab)));
+        out->bytes_wasted += (long)((p->capacity - p->live) * p->obj_size + p->slab_count * SLAB_ROUND(sizeof(struct Slab)));
     }
+    pthread_rwlock_unlock(&route_lock);
+    pthread_mutex_unlock(&state_lock);
+}
+
+/* ----------------- SLOT INVENTORY ----------------- */
+/* Slot s (1-based) is bit s-1 of slot_used. slot_full keeps one bit per word of
+   slot_used, set while that word has no free slot, so the lowest free slot is
+   two word scans and a ctz away. slot_owner maps each slot to its confirmed
+   record. The arrays always cover total_slots; everything here runs under
+   state_lock. booked_slots stays the count of confirmed records. */
+#define SLOT_SUMMARY_SPAN (64 * 64) /* slots covered by one slot_full word */
+
+static uint64_t *slot_used;
+static uint64_t *slot_full;
+static struct customer **slot_owner;
+static int slot_cap; /* a multiple of SLOT_SUMMARY_SPAN */
+
+/* Free runs per node of an implicit segment tree over the slot_used words: node
+   1 covers every slot, node i has children 2i and 2i+1, and word w is leaf
+   slot_leaves + w. pre/suf are the free slots at the node's low/high end and
+   best its longest free run, so k adjacent free slots are found in one descent.
+   Single-slot bookings do not need the tree, so marking a slot only flags its
+   word in slot_stale; slot_find_run brings those leaves up to date first. */
+struct SlotRun {
+    int pre, suf, best;
+};
+
+static struct SlotRun *slot_tree;
+static uint64_t *slot_stale; /* one bit per slot_used word changed since the last sync */
+static int slot_leaves; /* slot_cap / 64, a power of two */
+
+static void slot_leaf_set(int w) {
+    struct SlotRun *n = &slot_tree[slot_leaves + w];
+    uint64_t used = slot_used[w];
+    n->pre = used ? __builtin_ctzll(used) : 64;
+    n->suf = used ? __builtin_clzll(used) : 64;
+    n->best = 0;
+    /* one step per free run */
+    for (uint64_t x = ~used; x; ) {
+        x >>= __builtin_ctzll(x);
+        int run = ~x ? __builtin_ctzll(~x) : 64;
+        if (run > n->best) n->best = run;
+        x = run < 64 ? x >> run : 0;
+    }
+}
+
+/* half = slots covered by each child of node. Returns 0 if node is unchanged. */
+static int slot_pull(int node, int half) {
+    struct SlotRun *n = &slot_tree[node], *l = &slot_tree[2*node], *r = &slot_tree[2*node+1];
+    struct SlotRun v;
+    v.pre = l->pre == half ? half + r->pre : l->pre;
+    v.suf = r->suf == half ? half + l->suf : r->suf;
+    v.best = l->suf + r->pre;
+    if (l->best > v.best) v.best = l->best;
+    if (r->best > v.best) v.best = r->best;
+    if (v.pre == n->pre && v.suf == n->suf && v.best == n->best) return 0;
+    *n = v;
+    return 1;
+}
+
+static void slot_tree_update(int w) {
+    slot_leaf_set(w);
+    int half = 64;
+    for (int node = (slot_leaves + w) / 2; node >= 1 && slot_pull(node, half); node /= 2, half *= 2) {}
+}
+
+static void slot_tree_sync() {
+    for (int i = 0; i < slot_leaves / 64; i++) {
+        while (slot_stale[i]) {
+            slot_tree_update(i * 64 + __builtin_ctzll(slot_stale[i]));
+            slot_stale[i] &= slot_stale[i] - 1;
+        }
+    }
+}
+
+static int slot_tree_build() {
+    struct SlotRun *t = realloc(slot_tree, sizeof(struct SlotRun) * 2 * (slot_cap / 64));
+    if (!t) return -1;
+    slot_tree = t;
+    uint64_t *stale = realloc(slot_stale, sizeof(uint64_t) * (slot_cap / SLOT_SUMMARY_SPAN));
+    if (!stale) return -1;
+    slot_stale = stale;
+    memset(slot_stale, 0, sizeof(uint64_t) * (slot_cap / SLOT_SUMMARY_SPAN));
+    slot_leaves = slot_cap / 64;
+    for (int w = 0; w < slot_leaves; w++) slot_leaf_set(w);
+    for (int node = slot_leaves - 1; node >= 1; node--) {
+        int depth = 31 - __builtin_clz((unsigned)node);
+        slot_pull(node, slot_cap >> (depth + 1));
+    }
+    return 0;
+}
+
+/* First slot of the lowest run of k free slots within total_slots, or -1 */
+static int slot_find_run(int k) {
+    if (k < 1 || !slot_cap) return -1;
+    slot_tree_sync();
+    if (slot_tree[1].best < k) return -1;
+    int node = 1, lo = 0, half = slot_cap / 2;
+    int s = -1;
+    while (node < slot_leaves && s < 0) {
+        struct SlotRun *l = &slot_tree[2*node], *r = &slot_tree[2*node+1];
+        if (l->best >= k) node = 2*node;
+        else if (l->suf + r->pre >= k) s = lo + half - l->suf + 1;
+        else { node = 2*node+1; lo += half; }
+        half /= 2;
+    }
+    if (s < 0) {
+        /* the run lies inside one word: bit i of x survives if slots i..i+k-1 are free */
+        uint64_t free = ~slot_used[node - slot_leaves], x = free;
+        for (int j = 1; j < k; j++) x &= free >> j;
+        s = lo + __builtin_ctzll(x) + 1;
+    }
+    return s + k - 1 <= total_slots ? s : -1;
+}
+
+/* Makes the arrays cover at least n slots; new slots start free */
+static int slot_reserve(int n) {
+    if (n <= slot_cap) return 0;
+    int cap = slot_cap ? slot_cap : SLOT_SUMMARY_SPAN;
+    while (cap < n) cap *= 2;
+    uint64_t *used = realloc(slot_used, sizeof(uint64_t) * (cap / 64));
+    if (!used) return -1;
+    slot_used = used;
+    uint64_t *full = realloc(slot_full, sizeof(uint64_t) * (cap / SLOT_SUMMARY_SPAN));
+    if (!full) return -1;
+    slot_full = full;
+    struct customer **owner = realloc(slot_owner, sizeof(struct customer *) * cap);
+    if (!owner) return -1;
+    slot_owner = owner;
+    memset(slot_used + slot_cap / 64, 0, sizeof(uint64_t) * ((cap - slot_cap) / 64));
+    memset(slot_full + slot_cap / SLOT_SUMMARY_SPAN, 0, sizeof(uint64_t) * ((cap - slot_cap) / SLOT_SUMMARY_SPAN));
+    for (int i = slot_cap; i < cap; i++) slot_owner[i] = NULL;
+    int old_cap = slot_cap;
+    slot_cap = cap;
+    if (slot_tree_build() != 0) {
+        slot_cap = old_cap;
+        return -1;
+    }
+    return 0;
+}
+
+static void slot_free_all() {
+    free(slot_used);
+    free(slot_full);
+    free(slot_owner);
+    free(slot_tree);
+    free(slot_stale);
+    slot_used = slot_full = slot_stale = NULL;
+    slot_owner = NULL;
+    slot_tree = NULL;
+    slot_cap = slot_leaves = 0;
+}
+
+static void slot_mark(int slot, struct customer *c) {
+    int b = slot - 1, w = b / 64;
+    slot_used[w] |= 1ULL << (b & 63);
+    if (slot_used[w] == ~0ULL) slot_full[w / 64] |= 1ULL << (w & 63);
+    slot_owner[b] = c;
+    c->slot_number = slot;
+    slot_stale[w / 64] |= 1ULL << (w & 63);
+}
+
+/* Lowest free slot, or -1 when every slot in the arrays is taken */
+static int slot_find_free() {
+    for (int i = 0; i < slot_cap / SLOT_SUMMARY_SPAN; i++) {
+        uint64_t open = ~slot_full[i];
+        if (!open) continue;
+        int w = i * 64 + __builtin_ctzll(open);
+        return w * 64 + __builtin_ctzll(~slot_used[w]) + 1;
+    }
+    return -1;
+}
+
+/* Gives c the lowest free slot; the caller has checked booked_slots < total_slots */
+static int slot_take(struct customer *c) {
+    int s = slot_find_free();
+    if (s < 1 || s > total_slots) return -1;
+    slot_mark(s, c);
+    return s;
+}
+
+static void slot_release(struct customer *c) {
+    int b = c->slot_number - 1;
+    if (b < 0 || b >= slot_cap || slot_owner[b] != c) return;
+    int w = b / 64;
+    slot_used[w] &= ~(1ULL << (b & 63));
+    slot_full[w / 64] &= ~(1ULL << (w & 63));
+    slot_owner[b] = NULL;
+    slot_stale[w / 64] |= 1ULL << (w & 63);
+}
+
+/* Highest occupied slot, 0 if none */
+static int slot_highest_used() {
+    for (int w = slot_cap / 64 - 1; w >= 0; w--) {
+        if (slot_used[w]) return w * 64 + 63 - __builtin_clzll(slot_used[w]) + 1;
+    }
+    return 0;
+}
+
+/* Builds the inventory from confirmed_list once loading is done (the loaders
+   only restore slot_number). Files written before slots were tracked can hold
+   a slot twice or one past total_slots; such records get the lowest free slot
+   and are journaled again. */
+static void slot_rebuild_local() {
+    if (total_slots < confirmed_list.count) total_slots = confirmed_list.count;
+    booked_slots = confirmed_list.count;
+    if (slot_reserve(total_slots) != 0) return;
+    for (struct customer *c = confirmed_list.head; c; c = c->next) {
+        int s = c->slot_number;
+        if (s >= 1 && s <= total_slots && !slot_owner[s - 1]) slot_mark(s, c);
+    }
+    int moved = 0;
+    for (struct customer *c = confirmed_list.head; c; c = c->next) {
+        int s = c->slot_number;
+        if (s >= 1 && s <= total_slots && slot_owner[s - 1] == c) continue;
+        slot_take(c);
+        journal_put(c);
+        moved = 1;
+    }
+    if (moved) journal_meta();
+}
+
+/* ----------------- LOOKUP INDEX ----------------- */
+/* Secondary indexes over every record, confirmed or waitlisted: a chained hash
+   on contact and a treap on the case-folded name (ties broken by id), both
+   threaded through the records themselves. A name prefix is a contiguous run of
+   the treap, so a query costs O(log n + matches). Nothing is kept until the
+   first query builds both in one pass; from then on book, cancel, modify,
+   promotion and replay keep them current. Guarded by state_lock. */
+static struct {
+    int ready;
+    struct customer **contact; /* bucket heads */
+    unsigned cap;              /* power of two */
+    unsigned count;
+    struct customer *names;    /* treap root */
+} lookup;
+
+static unsigned contact_hash(const char *s) {
+    unsigned h = 2166136261u;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
+}
+
+static void contact_link(struct customer *c) {
+    struct customer **b = &lookup.contact[contact_hash(c->contact) & (lookup.cap - 1)];
+    c->contact_prev = NULL;
+    c->contact_next = *b;
+    if (*b) (*b)->contact_prev = c;
+    *b = c;
+}
+
+static void contact_unlink(struct customer *c) {
+    if (c->contact_prev) c->contact_prev->contact_next = c->contact_next;
+    else lookup.contact[contact_hash(c->contact) & (lookup.cap - 1)] = c->contact_next;
+    if (c->contact_next) c->contact_next->contact_prev = c->contact_prev;
+}
+
+/* Rehashes into cap buckets; keeps the old table if that fails */
+static int contact_resize(unsigned cap) {
+    struct customer **fresh = calloc(cap, sizeof(*fresh));
+    if (!fresh) return -1;
+    struct customer **old = lookup.contact;
+    unsigned old_cap = lookup.cap;
+    lookup.contact = fresh;
+    lookup.cap = cap;
+    for (unsigned i = 0; i < old_cap; i++) {
+        for (struct customer *c = old[i], *next; c; c = next) {
+            next = c->contact_next;
+            contact_link(c);
+        }
+    }
+    free(old);
+    return 0;
+}
+
+/* ASCII case-insensitive strncmp */
+static int name_fold_cmp(const char *a, const char *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        int x = tolower((unsigned char)a[i]), y = tolower((unsigned char)b[i]);
+        if (x != y || !x) return x - y;
+    }
+    return 0;
+}
+
+static int name_order(const struct customer *a, const struct customer *b) {
+    int cmp = name_fold_cmp(a->name, b->name, sizeof(a->name));
+    if (cmp) return cmp;
+    return (a->reservation_id > b->reservation_id) - (a->reservation_id < b->reservation_id);
+}
+
+static int name_order_qsort(const void *a, const void *b) {
+    return name_order(*(struct customer *const *)a, *(struct customer *const *)b);
+}
+
+/* treap priority, derived from the id so it needs no storage */
+static unsigned name_prio(const struct customer *c) {
+    return hashFunction(c->reservation_id);
+}
+
+static struct customer *name_insert(struct customer *t, struct customer *c) {
+    if (!t) {
+        c->name_left = c->name_right = NULL;
+        return c;
+    }
+    if (name_order(c, t) < 0) {
+        struct customer *l = t->name_left = name_insert(t->name_left, c);
+        if (name_prio(l) > name_prio(t)) {
+            t->name_left = l->name_right;
+            l->name_right = t;
+            return l;
+        }
+    } else {
+        struct customer *r = t->name_right = name_insert(t->name_right, c);
+        if (name_prio(r) > name_prio(t)) {
+            t->name_right = r->name_left;
+            r->name_left = t;
+            return r;
+        }
+    }
+    return t;
+}
+
+/* Joins two treaps where everything in a orders before b */
+static struct customer *name_merge(struct customer *a, struct customer *b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (name_prio(a) > name_prio(b)) {
+        a->name_right = name_merge(a->name_right, b);
+        return a;
+    }
+    b->name_left = name_merge(a, b->name_left);
+    return b;
+}
+
+static struct customer *name_remove(struct customer *t, struct customer *c) {
+    if (!t) return NULL;
+    if (t == c) return name_merge(t->name_left, t->name_right);
+    if (name_order(c, t) < 0) t->name_left = name_remove(t->name_left, c);
+    else t->name_right = name_remove(t->name_right, c);
+    return t;
+}
+
+/* Appends the ids of names starting with prefix (plen bytes) in name order */
+static void name_collect(const struct customer *t, const char *prefix, size_t plen, int ids[], int max, int *n) {
+    while (t && *n < max) {
+        int cmp = name_fold_cmp(t->name, prefix, plen);
+        if (cmp < 0) {
+            t = t->name_right;
+        } else if (cmp > 0) {
+            t = t->name_left;
+        } else {
+            name_collect(t->name_left, prefix, plen, ids, max, n);
+            if (*n < max) ids[(*n)++] = t->reservation_id;
+            t = t->name_right;
+        }
+    }
+}
+
+/* Called with the record's name and contact in place, after insertRecord */
+static void lookup_add(struct customer *c) {
+    if (!lookup.ready) return;
+    if (lookup.count >= lookup.cap) contact_resize(lookup.cap * 2);
+    contact_link(c);
+    lookup.count++;
+    lookup.names = name_insert(lookup.names, c);
+}
+
+/* Called before the record's name or contact changes or the record goes away */
+static void lookup_remove(struct customer *c) {
+    if (!lookup.ready) return;
+    contact_unlink(c);
+    lookup.count--;
+    lookup.names = name_remove(lookup.names, c);
+}
+
+static void lookup_reset() {
+    free(lookup.contact);
+    memset(&lookup, 0, sizeof(lookup));
+}
+
+/* Indexes every record at once: the names are sorted and the treap is laid out
+   over them with a stack along its right spine, in O(n log n) overall */
+static int lookup_build() {
+    if (lookup.ready) return 0;
+    unsigned n = (unsigned)(confirmed_list.count + waitlist.count), cap = 64;
+    while (cap < n) cap *= 2;
+    struct customer **sorted = malloc(sizeof(*sorted) * (n ? n : 1));
+    struct customer **spine = malloc(sizeof(*spine) * (n ? n : 1));
+    lookup.contact = calloc(cap, sizeof(*lookup.contact));
+    if (!sorted || !spine || !lookup.contact) {
+        free(sorted);
+        free(spine);
+        lookup_reset();
+        return -1;
+    }
+    lookup.cap = cap;
+    unsigned k = 0;
+    for (struct customer *c = confirmed_list.head; c; c = c->next) sorted[k++] = c;
+    for (struct customer *c = waitlist.head; c; c = c->next) sorted[k++] = c;
+    qsort(sorted, k, sizeof(*sorted), name_order_qsort);
+    unsigned depth = 0;
+    for (unsigned i = 0; i < k; i++) {
+        struct customer *c = sorted[i], *last = NULL;
+        contact_link(c);
+        c->name_left = c->name_right = NULL;
+        while (depth > 0 && name_prio(spine[depth - 1]) < name_prio(c)) last = spine[--depth];
+        c->name_left = last;
+        if (depth > 0) spine[depth - 1]->name_right = c;
+        spine[depth++] = c;
+    }
+    lookup.names = depth > 0 ? spine[0] : NULL;
+    lookup.count = k;
+    lookup.ready = 1;
+    free(sorted);
+    free(spine);
+    return 0;
+}
+
+int backend_find_by_contact(const char *contact, int ids[], int max) {
+    if (!contact || !ids || max < 1) return 0;
+    char key[sizeof(((struct customer *)0)->contact)];
+    strncpy(key, contact, sizeof(key) - 1); /* stored contacts are cut the same way */
+    key[sizeof(key) - 1] = '\0';
+    int n = 0;
+    pthread_mutex_lock(&state_lock);
+    if (lookup_build() != 0) {
+        pthread_mutex_unlock(&state_lock);
+        return -1;
+    }
+    for (struct customer *c = lookup.contact[contact_hash(key) & (lookup.cap - 1)]; c && n < max; c = c->contact_next) {
+        if (strcmp(c->contact, key) == 0) ids[n++] = c->reservation_id;
+    }
+    pthread_mutex_unlock(&state_lock);
+    return n;
+}
+
+int backend_find_by_name_prefix(const char *prefix, int ids[], int max) {
+    if (!prefix || !ids || max < 1) return 0;
+    size_t plen = strlen(prefix);
+    int n = 0;
+    pthread_mutex_lock(&state_lock);
+    if (lookup_build() != 0) {
+        pthread_mutex_unlock(&state_lock);
+        return -1;
+    }
+    name_collect(lookup.names, prefix, plen, ids, max, &n);
+    pthread_mutex_unlock(&state_lock);
+    return n;
+}
+
+/* ----------------- ROUTE INDEX ----------------- */
+/* Every record with a route is linked into the entry of its (from, to) pair,
+   which also keeps running totals of its confirmed bookings, waitlist depth and
+   the revenue of the confirmed ones. Entries sit in a chained hash table keyed
+   by the pair and are never dropped while records exist, so a query is a single
+   probe whatever the number of records. A record is taken out before its route,
+   cost or status changes and put back afterwards, which also keeps the waitlist
+   index up to date. Guarded by state_lock. */
+struct RoutePair {
+    int from, to;
+    int confirmed, waitlisted;
+    long long revenue;
+    struct customer *head;  /* records on this pair, no particular order */
+    struct WaitUnit *wait;  /* waitlist index: its waitlisted single bookings, NULL if none yet */
+    struct RoutePair *next; /* hash chain */
+};
+
+static struct {
+    struct RoutePair **bucket;
+    unsigned cap; /* power of two */
+    unsigned count;
+} route_index;
+
+static unsigned route_pair_hash(int from, int to) {
+    return ((unsigned)from * 0x9e3779b1u) ^ ((unsigned)to * 0x85ebca6bu);
+}
+
+static struct RoutePair *route_pair_find(int from, int to) {
+    if (!route_index.cap) return NULL;
+    struct RoutePair *e = route_index.bucket[route_pair_hash(from, to) & (route_index.cap - 1)];
+    while (e && (e->from != from || e->to != to)) e = e->next;
+    return e;
+}
+
+static struct RoutePair *route_pair_get(int from, int to) {
+    struct RoutePair *e = route_pair_find(from, to);
+    if (e) return e;
+    if (route_index.count >= route_index.cap) {
+        unsigned cap = route_index.cap ? route_index.cap * 2 : 64;
+        struct RoutePair **grown = calloc(cap, sizeof(*grown));
+        if (!grown) return NULL;
+        for (unsigned i = 0; i < route_index.cap; i++) {
+            for (struct RoutePair *x = route_index.bucket[i], *next; x; x = next) {
+                next = x->next;
+                unsigned b = route_pair_hash(x->from, x->to) & (cap - 1);
+                x->next = grown[b];
+                grown[b] = x;
+            }
+        }
+        free(route_index.bucket);
+        route_index.bucket = grown;
+        route_index.cap = cap;
+    }
+    e = calloc(1, sizeof(*e));
+    if (!e) return NULL;
+    e->from = from;
+    e->to = to;
+    unsigned b = route_pair_hash(from, to) & (route_index.cap - 1);
+    e->next = route_index.bucket[b];
+    route_index.bucket[b] = e;
+    route_index.count++;
+    return e;
+}
+
+/* Called once the record's route, cost and status are in place */
+static void route_index_add(struct customer *c) {
+    c->route_pair = NULL;
+    struct RoutePair *e = c->route_from >= 0 && c->route_to >= 0 ? route_pair_get(c->route_from, c->route_to) : NULL;
+    if (e) {
+        c->route_pair = e;
+        c->route_prev = NULL;
+        c->route_next = e->head;
+        if (e->head) e->head->route_prev = c;
+        e->head = c;
+        if (c->status == RES_WAITLISTED) {
+            e->waitlisted++;
+        } else {
+            e->confirmed++;
+            e->revenue += c->cost;
+        }
+    }
+    if (c->status == RES_WAITLISTED) wait_index_add(c);
+}
+
+/* Called before the record's route, cost or status changes or the record goes away */
+static void route_index_remove(struct customer *c) {
+    if (c->status == RES_WAITLISTED) wait_index_remove(c);
+    struct RoutePair *e = c->route_pair;
+    if (!e) return;
+    if (c->route_prev) c->route_prev->route_next = c->route_next;
+    else e->head = c->route_next;
+    if (c->route_next) c->route_next->route_prev = c->route_prev;
+    if (c->status == RES_WAITLISTED) {
+        e->waitlisted--;
+    } else {
+        e->confirmed--;
+        e->revenue -= c->cost;
+    }
+    c->route_pair = NULL;
+}
+
+static void route_index_reset() {
+    for (unsigned i = 0; i < route_index.cap; i++) {
+        for (struct RoutePair *e = route_index.bucket[i], *next; e; e = next) {
+            next = e->next;
+            free(e);
+        }
+    }
+    free(route_index.bucket);
+    memset(&route_index, 0, sizeof(route_index));
+}
+
+int backend_get_route_stats(int from, int to, struct backend_route_stats *out) {
+    if (!out) return -1;
+    memset(out, 0, sizeof(*out));
+    pthread_mutex_lock(&state_lock);
+    const struct RoutePair *e = route_pair_find(from, to);
+    if (e) {
+        out->confirmed = e->confirmed;
+        out->waitlisted = e->waitlisted;
+        out->revenue = e->revenue;
+    }
+    pthread_mutex_unlock(&state_lock);
+    return 0;
+}
+
+int backend_find_by_route(int from, int to, int ids[], int max) {
+    if (!ids || max < 1) return 0;
+    int n = 0;
+    pthread_mutex_lock(&state_lock);
+    const struct RoutePair *e = route_pair_find(from, to);
+    for (const struct customer *c = e ? e->head : NULL; c && n < max; c = c->route_next) ids[n++] = c->reservation_id;
+    pthread_mutex_unlock(&state_lock);
+    return n;
+}
+
+/* ----------------- PASSENGER LIST ----------------- */
+static unsigned long list_seq; /* last list_seq handed out, under state_lock */
+
+/* Both lists are O(1) to append to and to unlink from given the record
+   (found through the index), so bulk loads stay linear. The helpers below run
+   under state_lock and leave the id index to the caller, who holds the shard
+   lock: insertRecord() after a record is created, deleteRecord() before it is
+   dropped. */
+static void list_append(struct CustomerList *l, struct customer *c) {
+    c->list_seq = ++list_seq;
+    c->next = NULL;
+    c->prev = l->tail;
+    if (l->tail) l->tail->next = c;
+    else l->head = c;
+    l->tail = c;
+    l->count++;
+}
+
+static void list_unlink(struct CustomerList *l, struct customer *c) {
+    if (c->prev) c->prev->next = c->next;
+    else l->head = c->next;
+    if (c->next) c->next->prev = c->prev;
+    else l->tail = c->prev;
+    c->next = c->prev = NULL;
+    l->count--;
+}
+
+static struct customer *insert_customer_local(int reservation_id, const char name[], int age, const char contact[], int slot_number, int route_from, int route_to, int cost) {
+    struct customer *newc = slab_alloc(&customer_pool);
+    if (!newc) return NULL;
+    newc->reservation_id = reservation_id;
+    strncpy(newc->name, name, sizeof(newc->name)-1); newc->name[sizeof(newc->name)-1]='\0';
+    newc->age = age;
+    strncpy(newc->contact, contact, sizeof(newc->contact)-1); newc->contact[sizeof(newc->contact)-1]='\0';
+    newc->slot_number = slot_number;
+    newc->route_from = route_from;
+    newc->route_to = route_to;
+    newc->cost = cost;
+    newc->group_id = 0;
+    newc->path_rank = 0;
+    newc->status = RES_CONFIRMED;
+    list_append(&confirmed_list, newc);
+    lookup_add(newc);
+    route_index_add(newc);
+    return newc;
+}
+
+static void delete_customer_local(struct customer *c) {
+    const struct LegPath *p = leg_path(c->route_from, c->route_to, c->path_rank);
+    legs_take(p, -1);
+    wait_wake_path(p);
+    list_unlink(&confirmed_list, c);
+    lookup_remove(c);
+    route_index_remove(c);
+    slot_release(c);
+    epoch_retire(c, RETIRE_RECORD);
+    booked_slots--;
+}
+
+/* ----------------- WAITLIST ----------------- */
+static struct customer *enqueue_waitlist_local(int reservation_id, const char name[], int age, const char contact[], int route_from, int route_to, int cost, int group_id) {
+    struct customer *newr = slab_alloc(&customer_pool);
+    if (!newr) return NULL;
+    newr->reservation_id = reservation_id;
+    strncpy(newr->name, name, sizeof(newr->name)-1); newr->name[sizeof(newr->name)-1]='\0';
+    newr->age = age;
+    strncpy(newr->contact, contact, sizeof(newr->contact)-1); newr->contact[sizeof(newr->contact)-1]='\0';
+    newr->slot_number = -1;
+    newr->route_from = route_from;
+    newr->route_to = route_to;
+    newr->cost = cost;
+    newr->group_id = group_id;
+    newr->path_rank = 0;
+    newr->status = RES_WAITLISTED;
+    list_append(&waitlist, newr);
+    lookup_add(newr);
+    route_index_add(newr);
+    return newr;
+}
+
+/* Drops a waitlisted record found through the index; O(1) thanks to prev links */
+static void remove_waitlist_local(struct customer *c) {
+    list_unlink(&waitlist, c);
+    lookup_remove(c);
+    route_index_remove(c);
+    epoch_retire(c, RETIRE_RECORD);
+}
+
+/* ----------------- GRAPH UTILITIES (Dijkstra) ----------------- */
+void add_edge_local(struct Graph *g, int u, int v, int w) {
+    struct Edge *e = slab_alloc(&edge_pool);
+    if (!e) return;
+    e->to = v; e->weight = w; e->leg = g->legs; e->next = g->adj[u];
+    g->adj[u] = e;
+    struct Edge *e2 = slab_alloc(&edge_pool);
+    if (!e2) return;
+    e2->to = u; e2->weight = w; e2->leg = g->legs; e2->next = g->adj[v];
+    g->adj[v] = e2;
+    g->legs++;
+    route_graph_version++;
+}
+
+static void free_graph_local(struct Graph *g) {
+    if (!g) return;
+    for (int i = 0; i < g->n; i++) {
+        struct Edge *e = g->adj[i];
+        while (e) {
+            struct Edge *nx = e->next;
+            slab_free(&edge_pool, e);
+            e = nx;
+        }
+    }
+    free(g->adj);
+    free(g);
+}
+
+static int route_csr_current() {
+    return route_graph && route_csr.version == route_graph_version && route_csr.n == route_graph->n;
+}
+
+/* Flattens route_graph into route_csr if the graph changed since the last build.
+   Edges of node u live in target/weight[offset[u] .. offset[u+1]).
+   Needs route_lock held exclusively. */
+static int build_route_csr() {
+    struct Graph *g = route_graph;
+    if (!g) return -1;
+    if (route_csr_current()) return 0;
+
+    int m = 0;
+    for (int u = 0; u < g->n; u++)
+        for (struct Edge *e = g->adj[u]; e; e = e->next) m++;
+
+    int *offset = malloc(sizeof(int) * (g->n + 1));
+    int *target = malloc(sizeof(int) * (m > 0 ? m : 1));
+    int *weight = malloc(sizeof(int) * (m > 0 ? m : 1));
+    int *leg = malloc(sizeof(int) * (m > 0 ? m : 1));
+    if (!offset || !target || !weight || !leg) {
+        free(offset); free(target); free(weight); free(leg);
+        return -1;
+    }
+    int k = 0;
+    for (int u = 0; u < g->n; u++) {
+        offset[u] = k;
+        for (struct Edge *e = g->adj[u]; e; e = e->next) {
+            target[k] = e->to;
+            weight[k] = e->weight;
+            leg[k] = e->leg;
+            k++;
+        }
+    }
+    offset[g->n] = k;
+
+    free(route_csr.offset); free(route_csr.target); free(route_csr.weight); free(route_csr.leg);
+    route_csr.n = g->n;
+    route_csr.m = m;
+    route_csr.offset = offset;
+    route_csr.target = target;
+    route_csr.weight = weight;
+    route_csr.leg = leg;
+    route_csr.version = route_graph_version;
+    return 0;
+}
+
+/* Makes sure this thread's scratch buffers hold n nodes and starts a new run.
+   Entries whose stamp differs from cur_stamp are treated as untouched, so a run
+   only pays for the nodes it actually reaches. */
+static int scratch_begin(struct DijkstraScratch *s, int n) {
+    if (s->cap < n) {
+        int cap = s->cap ? s->cap : 64;
+        while (cap < n) cap *= 2;
+        struct NodeState *node = realloc(s->node, sizeof(struct NodeState) * cap);
+        if (!node) return -1;
+        s->node = node;
+        struct HeapEntry *heap = realloc(s->heap, sizeof(struct HeapEntry) * cap);
+        if (!heap) return -1;
+        s->heap = heap;
+        for (int i = s->cap; i < cap; i++) s->node[i].stamp = 0;
+        s->cap = cap;
+    }
+    if (++s->cur_stamp == 0) {
+        /* stamp wrapped around: clear everything once */
+        for (int i = 0; i < s->cap; i++) s->node[i].stamp = 0;
+        s->cur_stamp = 1;
+    }
+    s->heap_len = 0;
+    return 0;
+}
+
+static struct NodeState *scratch_touch(struct DijkstraScratch *s, int v) {
+    struct NodeState *ns = &s->node[v];
+    if (ns->stamp != s->cur_stamp) {
+        ns->stamp = s->cur_stamp;
+        ns->dist = INT_MAX;
+        ns->prev = -1;
+        ns->pos = -1;
+    }
+    return ns;
+}
+
+/* Indexed binary min-heap keyed by distance; pos[] tracks each node's heap slot so
+   relaxations are a decrease-key instead of a duplicate push. The key is stored
+   next to the node so sifting never has to chase dist[]. */
+static void heap_sift_up(struct DijkstraScratch *s, int i, struct HeapEntry x) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        struct HeapEntry p = s->heap[parent];
+        if (p.key <= x.key) break;
+        s->heap[i] = p;
+        s->node[p.node].pos = i;
+        i = parent;
+    }
+    s->heap[i] = x;
+    s->node[x.node].pos = i;
+}
+
+static void heap_sift_down(struct DijkstraScratch *s, int i, struct HeapEntry x) {
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= s->heap_len) break;
+        if (child + 1 < s->heap_len && s->heap[child + 1].key < s->heap[child].key) child++;
+        struct HeapEntry c = s->heap[child];
+        if (x.key <= c.key) break;
+        s->heap[i] = c;
+        s->node[c.node].pos = i;
+        i = child;
+    }
+    s->heap[i] = x;
+    s->node[x.node].pos = i;
+}
+
+static int heap_pop(struct DijkstraScratch *s) {
+    int top = s->heap[0].node;
+    s->heap_len--;
+    if (s->heap_len > 0) heap_sift_down(s, 0, s->heap[s->heap_len]);
+    s->node[top].pos = -2;
+    return top;
+}
+
+/* Runs Dijkstra from src over route_csr into this thread's scratch buffers.
+   Stops early once dest is settled (pass dest = -1 to settle every reachable node).
+   Nodes flagged in skip_node and legs flagged in skip_leg are left out (either may
+   be NULL). Returns the scratch on success, NULL on allocation failure. */
+static struct DijkstraScratch *dijkstra_run(int src, int dest, const unsigned char *skip_node, const unsigned char *skip_leg) {
+    struct DijkstraScratch *s = &dj_scratch;
+    const struct RouteCSR *g = &route_csr;
+    if (scratch_begin(s, g->n) != 0) return NULL;
+
+    struct NodeState *ns = scratch_touch(s, src);
+    ns->dist = 0;
+    ns->pos = 0;
+    s->heap[0].key = 0;
+    s->heap[0].node = src;
+    s->heap_len = 1;
+
+    unsigned long settled = 0;
+    while (s->heap_len > 0) {
+        int u = heap_pop(s);
+        settled++;
+        if (u == dest) break;
+        int du = s->node[u].dist;
+        for (int k = g->offset[u]; k < g->offset[u + 1]; k++) {
+            int v = g->target[k];
+            if ((skip_node && skip_node[v]) || (skip_leg && skip_leg[g->leg[k]])) continue;
+            struct NodeState *nv = scratch_touch(s, v);
+            if (nv->pos == -2) continue;
+            int nd = du + g->weight[k];
+            if (nd < nv->dist) {
+                nv->dist = nd;
+                nv->prev = u;
+                struct HeapEntry x = { nd, v };
+                heap_sift_up(s, nv->pos == -1 ? s->heap_len++ : nv->pos, x);
+            }
+        }
+    }
+    STAT_ADD(dijkstra_runs, 1);
+    STAT_ADD(dijkstra_settled, settled);
+    return s;
+}
+
+/* Dijkstra: returns 0 on success; out_distance set to distance (>=0).
+   If no path exists, out_distance is set to -1 and function returns -1.
+   If out_path and out_len provided, path (sequence of node indices) is written into out_path (up to out_path_len),
+   and *out_len is set to the path length.
+*/
+static int dijkstra_shortest_path(struct Graph *g, int src, int dest, int *out_distance, int out_path[], int *out_len, int out_path_len) {
+    if (!g || g != route_graph) return -1;
+    if (src < 0 || src >= g->n || dest < 0 || dest >= g->n) return -1;
+    if (!route_csr_current()) return -1;
+
+    struct DijkstraScratch *s = dijkstra_run(src, dest, NULL, NULL);
+    if (!s) return -1;
+
+    struct NodeState *nd = &s->node[dest];
+    if (nd->stamp != s->cur_stamp || nd->dist == INT_MAX) {
+        if (out_distance) *out_distance = -1;
+        if (out_len) *out_len = 0;
+        return -1;
+    }
+
+    if (out_distance) *out_distance = nd->dist;
+
+    if (out_path && out_len) {
+        int len = 0;
+        for (int cur = dest; cur != -1; cur = s->node[cur].prev) len++;
+        /* walk back from dest, keeping only the first out_path_len nodes of the path */
+        int i = len - 1;
+        for (int cur = dest; cur != -1; cur = s->node[cur].prev, i--) {
+            if (i < out_path_len) out_path[i] = cur;
+        }
+        *out_len = (len < out_path_len) ? len : out_path_len;
+    }
+    return 0;
+}
+
+/* Takes route_lock shared with route_csr up to date, rebuilding it under the
+   exclusive lock first if the graph changed */
+static void route_read_lock() {
+    pthread_rwlock_rdlock(&route_lock);
+    while (route_graph && !route_csr_current()) {
+        pthread_rwlock_unlock(&route_lock);
+        pthread_rwlock_wrlock(&route_lock);
+        int rc = build_route_csr();
+        pthread_rwlock_unlock(&route_lock);
+        pthread_rwlock_rdlock(&route_lock);
+        if (rc != 0) break; /* out of memory: lookups fail until the next try */
+    }
+}
+
+/* ----------------- ROUTE COST CACHE ----------------- */
+/* Caches full distance rows (one Dijkstra run per source city) so pricing a
+   ticket is a lookup. Rows are dropped wholesale when route_graph_version moves. */
+static void route_cache_reset(int n) {
+    for (int i = 0; i < route_cache.used; i++) free(route_cache.rows[i].dist);
+    route_cache.used = 0;
+    route_cache.next_victim = 0;
+    if (route_cache.n != n) {
+        free(route_cache.row_of);
+        route_cache.row_of = malloc(sizeof(int) * n);
+        route_cache.n = route_cache.row_of ? n : 0;
+    }
+    for (int i = 0; i < route_cache.n; i++) route_cache.row_of[i] = -1;
+    /* keep the matrix under ROUTE_CACHE_MAX_CELLS ints */
+    long rows = n > 0 ? ROUTE_CACHE_MAX_CELLS / n : 0;
+    if (rows > ROUTE_CACHE_MAX_ROWS) rows = ROUTE_CACHE_MAX_ROWS;
+    if (rows < 1) rows = 1;
+    route_cache.max_rows = (int)rows;
+    route_cache.version = route_graph_version;
+}
+
+/* Returns the cached distance row for src, running Dijkstra on a miss.
+   Caller holds route_lock and route_cache_lock for as long as it reads the row. */
+static const int *route_cache_row(int src) {
+    if (!route_csr_current()) return NULL;
+    if (route_cache.version != route_graph_version || route_cache.n != route_graph->n) {
+        route_cache_reset(route_graph->n);
+    }
+    if (src < 0 || src >= route_cache.n) return NULL;
+
+    int r = route_cache.row_of[src];
+    if (r >= 0) {
+        route_cache.hits++;
+        return route_cache.rows[r].dist;
+    }
+    route_cache.misses++;
+
+    struct DijkstraScratch *s = dijkstra_run(src, -1, NULL, NULL);
+    if (!s) return NULL;
+
+    int *dist;
+    if (route_cache.used < route_cache.max_rows) {
+        r = route_cache.used;
+        dist = malloc(sizeof(int) * route_cache.n);
+        if (!dist) return NULL;
+        route_cache.used++;
+    } else {
+        /* full: recycle rows round-robin */
+        r = route_cache.next_victim;
+        route_cache.next_victim = (r + 1) % route_cache.max_rows;
+        route_cache.row_of[route_cache.rows[r].src] = -1;
+        dist = route_cache.rows[r].dist;
+    }
+    for (int v = 0; v < route_cache.n; v++) {
+        const struct NodeState *ns = &s->node[v];
+        dist[v] = (ns->stamp == s->cur_stamp && ns->dist != INT_MAX) ? ns->dist : -1;
+    }
+    route_cache.rows[r].src = src;
+    route_cache.rows[r].dist = dist;
+    route_cache.row_of[src] = r;
+    return dist;
+}
+
+/* Fills the whole matrix up front for small graphs (route_lock held exclusively). */
+static void route_cache_warm() {
+    if (!route_graph || route_graph->n > ROUTE_CACHE_EAGER_MAX) return;
+    if (build_route_csr() != 0) return;
+    pthread_mutex_lock(&route_cache_lock);
+    for (int src = 0; src < route_graph->n; src++) route_cache_row(src);
+    route_cache.hits = 0;
+    route_cache.misses = 0;
+    pthread_mutex_unlock(&route_cache_lock);
+}
+
+void backend_get_route_cache_stats(struct backend_route_cache_stats *out) {
+    if (!out) return;
+    pthread_mutex_lock(&route_cache_lock);
+    out->hits = route_cache.hits;
+    out->misses = route_cache.misses;
+    out->rows_cached = route_cache.used;
+    pthread_mutex_unlock(&route_cache_lock);
+}
+
+/* Helper: compute distance and cost if path exists. Returns distance or -1 if no path.
+   Caller holds route_read_lock(). */
+static int compute_route_distance_and_cost(int from, int to, int *out_cost) {
+    if (!route_graph) return -1;
+    if (from < 0 || from >= route_graph->n || to < 0 || to >= route_graph->n) return -1;
+    pthread_mutex_lock(&route_cache_lock);
+    const int *row = route_cache_row(from);
+    int dist = row ? row[to] : -1;
+    pthread_mutex_unlock(&route_cache_lock);
+    if (dist < 0) return -1;
+    if (out_cost) *out_cost = dist * PRICE_PER_UNIT;
+    return dist;
+}
+
+/* Republishes total_slots/booked_slots for backend_get_availability_text();
+   called under state_lock after every change to either */
+static void slots_publish() {
+    unsigned seq = atomic_load_explicit(&slots_pub.seq, memory_order_relaxed);
+    atomic_store_explicit(&slots_pub.seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&slots_pub.total, total_slots, memory_order_relaxed);
+    atomic_store_explicit(&slots_pub.booked, booked_slots, memory_order_relaxed);
+    atomic_store_explicit(&slots_pub.seq, seq + 2, memory_order_release);
+}
+
+/* Consistent total/booked pair without locking; retries if a write overlapped */
+static void slots_read(int *total, int *booked) {
+    unsigned seq;
+    do {
+        seq = atomic_load_explicit(&slots_pub.seq, memory_order_acquire);
+        *total = atomic_load_explicit(&slots_pub.total, memory_order_relaxed);
+        *booked = atomic_load_explicit(&slots_pub.booked, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || atomic_load_explicit(&slots_pub.seq, memory_order_relaxed) != seq);
+}
+
+/* ----------------- ALTERNATIVE ROUTES ----------------- */
+/* Yen's algorithm: the next shortest loopless path is the cheapest spur off a
+   path already found. From every node of the last path, Dijkstra reruns with
+   the nodes before it removed, and with the edges leaving it that earlier paths
+   on the same prefix already took. The leg inventory keeps ROUTE_CHOICES paths
+   per (from, to) so a booking can fall back to a longer route when a leg of the
+   shortest one is full. Everything here needs route_lock shared with the CSR
+   current. */
+#define ROUTE_CHOICES 4 /* candidate paths kept per (from, to), shortest first */
+
+struct YenPath {
+    int dist;
+    int len;   /* nodes */
+    int *nodes;
+    int *acc;  /* distance from the source to nodes[i] */
+    int *legs; /* len - 1 entries */
+};
+
+static int yen_alloc(struct YenPath *p, int len) {
+    p->nodes = malloc(sizeof(int) * 3 * len);
+    if (!p->nodes) return -1;
+    p->acc = p->nodes + len;
+    p->legs = p->acc + len;
+    p->len = len;
+    return 0;
+}
+
+/* Leg of the cheapest edge u->v not in skip_leg, -1 if none; its weight goes to *weight */
+static int csr_edge_between(int u, int v, const unsigned char *skip_leg, int *weight) {
+    int best = -1, best_w = INT_MAX;
+    for (int k = route_csr.offset[u]; k < route_csr.offset[u + 1]; k++) {
+        if (route_csr.target[k] != v || (skip_leg && skip_leg[route_csr.leg[k]])) continue;
+        if (route_csr.weight[k] < best_w) {
+            best = route_csr.leg[k];
+            best_w = route_csr.weight[k];
+        }
+    }
+    if (weight) *weight = best_w;
+    return best;
+}
+
+/* Shortest path to `to` that follows base up to base->nodes[i] and then leaves
+   it under the masks (base == NULL: plain shortest path from src). 0 on success. */
+static int yen_spur(const struct YenPath *base, int i, int src, int to,
+                    const unsigned char *skip_node, const unsigned char *skip_leg, struct YenPath *out) {
+    int spur = base ? base->nodes[i] : src;
+    int root = base ? i : 0; /* nodes before the spur node */
+    struct DijkstraScratch *s = dijkstra_run(spur, to, skip_node, skip_leg);
+    if (!s) return -1;
+    const struct NodeState *nd = &s->node[to];
+    if (nd->stamp != s->cur_stamp || nd->dist == INT_MAX) return -1;
+    int m = 0;
+    for (int v = to; v != -1; v = s->node[v].prev) m++;
+    if (yen_alloc(out, root + m) != 0) return -1;
+    if (base) {
+        memcpy(out->nodes, base->nodes, sizeof(int) * root);
+        memcpy(out->acc, base->acc, sizeof(int) * (root + 1));
+        memcpy(out->legs, base->legs, sizeof(int) * root);
+    } else {
+        out->acc[0] = 0;
+    }
+    int j = root + m - 1;
+    for (int v = to; v != -1; v = s->node[v].prev) out->nodes[j--] = v;
+    for (j = root + 1; j < root + m; j++) {
+        int w = 0;
+        out->legs[j - 1] = csr_edge_between(out->nodes[j - 1], out->nodes[j], skip_leg, &w);
+        out->acc[j] = out->acc[j - 1] + w;
+    }
+    out->dist = out->acc[root + m - 1];
+    return 0;
+}
+
+/* 1 if a and b share their first n nodes and the legs between them */
+static int yen_same_prefix(const struct YenPath *a, const struct YenPath *b, int n) {
+    return a->len >= n && b->len >= n &&
+           memcmp(a->nodes, b->nodes, sizeof(int) * n) == 0 &&
+           memcmp(a->legs, b->legs, sizeof(int) * (n - 1)) == 0;
+}
+
+static int yen_contains(const struct YenPath *set, int count, const struct YenPath *p) {
+    for (int i = 0; i < count; i++) {
+        if (set[i].len == p->len && yen_same_prefix(&set[i], p, p->len)) return 1;
+    }
+    return 0;
+}
+
+/* Up to max loopless from->to paths into out[], shortest first; returns how
+   many. The caller frees out[i].nodes. */
+static int yen_k_shortest(int from, int to, struct YenPath out[], int max) {
+    int n = route_csr.n, nlegs = route_graph->legs;
+    unsigned char *skip_node = calloc(n, 1);
+    unsigned char *skip_leg = calloc(nlegs > 0 ? nlegs : 1, 1);
+    struct YenPath *cand = NULL;
+    int ncand = 0, cand_cap = 0, found = 0;
+    if (skip_node && skip_leg && max > 0 && yen_spur(NULL, 0, from, to, NULL, NULL, &out[0]) == 0) found = 1;
+    while (found > 0 && found < max) {
+        const struct YenPath *last = &out[found - 1];
+        for (int i = 0; i + 1 < last->len; i++) {
+            for (int a = 0; a < found; a++) {
+                if (out[a].len > i + 1 && yen_same_prefix(&out[a], last, i + 1)) skip_leg[out[a].legs[i]] = 1;
+            }
+            for (int r = 0; r < i; r++) skip_node[last->nodes[r]] = 1;
+            struct YenPath p;
+            if (yen_spur(last, i, from, to, skip_node, skip_leg, &p) == 0) {
+                if (yen_contains(out, found, &p) || yen_contains(cand, ncand, &p)) {
+                    free(p.nodes);
+                } else {
+                    if (ncand == cand_cap) {
+                        int cap = cand_cap ? cand_cap * 2 : 8;
+                        struct YenPath *c = realloc(cand, sizeof(struct YenPath) * cap);
+                        if (!c) { free(p.nodes); break; }
+                        cand = c;
+                        cand_cap = cap;
+                    }
+                    cand[ncand++] = p;
+                }
+            }
+            for (int a = 0; a < found; a++) {
+                if (out[a].len > i + 1) skip_leg[out[a].legs[i]] = 0;
+            }
+            for (int r = 0; r < i; r++) skip_node[last->nodes[r]] = 0;
+        }
+        if (ncand == 0) break;
+        int best = 0;
+        for (int c = 1; c < ncand; c++) {
+            if (cand[c].dist < cand[best].dist || (cand[c].dist == cand[best].dist && cand[c].len < cand[best].len)) best = c;
+        }
+        out[found++] = cand[best];
+        cand[best] = cand[--ncand];
+    }
+    for (int c = 0; c < ncand; c++) free(cand[c].nodes);
+    free(cand);
+    free(skip_node);
+    free(skip_leg);
+    return found;
+}
+
+/* ----------------- LEG INVENTORY ----------------- */
+/* Every undirected edge of route_graph is a leg with its own seat count. A
+   confirmed booking holds one seat on each leg of one of the candidate paths
+   between its cities, the cheapest that had room when it was confirmed (its
+   path_rank), and is waitlisted if none has. Paths are arbitrary edge sets
+   rather than ranges of one line, so the per-leg counters are a flat array and
+   the candidates of each (from, to) pair are cached: a fit check costs one
+   lookup plus one compare per leg, however many bookings exist. Leg ids follow
+   the graph, so when route_graph_version moves the counters are rebuilt from
+   the confirmed list and the capacities are applied again from leg_caps, which
+   keeps them by city pair, persists them and is only cleared by
+   backend_load_routes. Everything here runs under state_lock; changes also take
+   legs_lock exclusively, so backend_get_shortest_path_text can read the
+   candidates and counters with legs_lock shared instead of waiting for
+   bookings. */
+#define LEG_ROUTES_INITIAL_CAP 64
+
+struct LegPath {
+    int dist;
+    int count;  /* legs */
+    int *nodes; /* count + 1 cities, stored after legs */
+    int legs[];
+};
+
+/* candidate paths of one (from, to) pair, shortest first */
+struct RouteChoices {
+    int from, to;
+    int count;
+    struct LegPath *path[ROUTE_CHOICES];
+};
+
+static pthread_rwlock_t legs_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static struct {
+    int *cap;  /* seats per leg, BACKEND_LEG_UNLIMITED for no limit */
+    int *used;
+    int count;
+    unsigned version; /* route_graph_version the arrays describe, 0 = not built */
+    struct RouteChoices **routes; /* open addressing on (from, to); NULL = empty */
+    unsigned route_cap;
+    unsigned route_count;
+} legs;
+
+/* capacities other than unlimited, in the order they were first set */
+static struct {
+    struct LegCap *items;
+    int count;
+    int size;
+} leg_caps;
+
+static void leg_caps_clear() {
+    free(leg_caps.items);
+    leg_caps.items = NULL;
+    leg_caps.count = leg_caps.size = 0;
+}
+
+/* Records the seats of leg from - to; -1 if out of memory */
+static int leg_caps_save(int from, int to, int seats) {
+    if (from > to) { int t = from; from = to; to = t; }
+    int i = 0;
+    while (i < leg_caps.count && (leg_caps.items[i].from != from || leg_caps.items[i].to != to)) i++;
+    if (seats == BACKEND_LEG_UNLIMITED) {
+        if (i < leg_caps.count) leg_caps.items[i] = leg_caps.items[--leg_caps.count];
+        return 0;
+    }
+    if (i == leg_caps.size) {
+        int size = leg_caps.size ? leg_caps.size * 2 : 16;
+        struct LegCap *items = realloc(leg_caps.items, sizeof(struct LegCap) * size);
+        if (!items) return -1;
+        leg_caps.items = items;
+        leg_caps.size = size;
+    }
+    if (i == leg_caps.count) leg_caps.count++;
+    leg_caps.items[i].from = from;
+    leg_caps.items[i].to = to;
+    leg_caps.items[i].seats = seats;
+    return 0;
+}
+
+static void route_choices_free(struct RouteChoices *rc) {
+    for (int r = 0; rc && r < rc->count; r++) free(rc->path[r]);
+    free(rc);
+}
+
+static void leg_routes_clear() {
+    for (unsigned i = 0; i < legs.route_cap; i++) route_choices_free(legs.routes[i]);
+    free(legs.routes);
+    legs.routes = NULL;
+    legs.route_cap = legs.route_count = 0;
+}
+
+static void legs_reset() {
+    leg_routes_clear();
+    free(legs.cap);
+    free(legs.used);
+    legs.cap = legs.used = NULL;
+    legs.count = 0;
+    legs.version = 0;
+}
+
+static unsigned leg_route_hash(int from, int to) {
+    return hashFunction(from * 31 + to * 1000003);
+}
+
+static struct RouteChoices *route_choices_build(int from, int to) {
+    struct RouteChoices *rc = calloc(1, sizeof(struct RouteChoices));
+    if (!rc) return NULL;
+    rc->from = from;
+    rc->to = to;
+    struct YenPath found[ROUTE_CHOICES];
+    int n = yen_k_shortest(from, to, found, ROUTE_CHOICES);
+    for (int r = 0; r < n; r++) {
+        int count = found[r].len - 1;
+        struct LegPath *p = malloc(sizeof(struct LegPath) + sizeof(int) * (2 * count + 1));
+        if (p) {
+            p->dist = found[r].dist;
+            p->count = count;
+            p->nodes = p->legs + count;
+            memcpy(p->legs, found[r].legs, sizeof(int) * count);
+            memcpy(p->nodes, found[r].nodes, sizeof(int) * (count + 1));
+            rc->path[rc->count++] = p;
+        }
+        free(found[r].nodes);
+    }
+    return rc;
+}
+
+/* Cached candidates from -> to, NULL if not computed yet. Caller holds
+   legs_lock. */
+static const struct RouteChoices *route_choices_find(int from, int to) {
+    unsigned mask = legs.route_cap - 1;
+    if (legs.route_cap) {
+        for (unsigned i = leg_route_hash(from, to) & mask; legs.routes[i]; i = (i + 1) & mask) {
+            if (legs.routes[i]->from == from && legs.routes[i]->to == to) return legs.routes[i];
+        }
+    }
+    return NULL;
+}
+
+/* Files rc in the cache, or frees it if another thread filed the pair first,
+   and returns the cached list; NULL (rc freed) if the table cannot grow.
+   Caller holds legs_lock exclusively. */
+static const struct RouteChoices *route_choices_add(struct RouteChoices *rc) {
+    const struct RouteChoices *found = route_choices_find(rc->from, rc->to);
+    if (found) {
+        route_choices_free(rc);
+        return found;
+    }
+    unsigned mask = legs.route_cap - 1;
+    if ((legs.route_count + 1) * 2 > legs.route_cap) {
+        unsigned cap = legs.route_cap ? legs.route_cap * 2 : LEG_ROUTES_INITIAL_CAP;
+        struct RouteChoices **routes = calloc(cap, sizeof(struct RouteChoices *));
+        if (!routes) {
+            route_choices_free(rc);
+            return NULL;
+        }
+        for (unsigned i = 0; i < legs.route_cap; i++) {
+            struct RouteChoices *rc = legs.routes[i];
+            if (!rc) continue;
+            unsigned j = leg_route_hash(rc->from, rc->to) & (cap - 1);
+            while (routes[j]) j = (j + 1) & (cap - 1);
+            routes[j] = rc;
+        }
+        free(legs.routes);
+        legs.routes = routes;
+        legs.route_cap = cap;
+        mask = cap - 1;
+    }
+    unsigned i = leg_route_hash(rc->from, rc->to) & mask;
+    while (legs.routes[i]) i = (i + 1) & mask;
+    legs.routes[i] = rc;
+    legs.route_count++;
+    return rc;
+}
+
+/* Candidate paths from -> to, computed on first use; NULL for an invalid pair.
+   Caller holds state_lock and route_lock shared. */
+static const struct RouteChoices *route_choices_locked(int from, int to) {
+    if (!route_graph || from < 0 || from >= route_graph->n || to < 0 || to >= route_graph->n) return NULL;
+    /* path queries fill the cache without state_lock, so even a lookup locks */
+    pthread_rwlock_rdlock(&legs_lock);
+    const struct RouteChoices *found = route_choices_find(from, to);
+    pthread_rwlock_unlock(&legs_lock);
+    if (found) return found;
+    struct RouteChoices *rc = route_choices_build(from, to);
+    if (!rc) return NULL;
+    pthread_rwlock_wrlock(&legs_lock);
+    found = route_choices_add(rc);
+    pthread_rwlock_unlock(&legs_lock);
+    return found;
+}
+
+/* Path of the given rank; NULL if there is none (such bookings hold no seats).
+   Caller holds route_lock shared. */
+static const struct LegPath *leg_path_locked(int from, int to, int rank) {
+    const struct RouteChoices *rc = route_choices_locked(from, to);
+    return rc && rank >= 0 && rank < rc->count ? rc->path[rank] : NULL;
+}
+
+/* Rebuilds the counters if the graph changed. Caller holds state_lock and
+   route_lock shared. */
+static void legs_sync_locked() {
+    if (!route_graph || !route_csr_current() || legs.version == route_graph_version) return;
+    pthread_rwlock_wrlock(&legs_lock);
+    legs_reset();
+    pthread_rwlock_unlock(&legs_lock);
+    int count = route_graph->legs;
+    int *cap = malloc(sizeof(int) * (count > 0 ? count : 1));
+    int *used = calloc(count > 0 ? count : 1, sizeof(int));
+    if (!cap || !used) { free(cap); free(used); return; }
+    for (int i = 0; i < count; i++) cap[i] = BACKEND_LEG_UNLIMITED;
+    for (int i = 0; i < leg_caps.count; i++) {
+        const struct LegCap *lc = &leg_caps.items[i];
+        int leg = lc->from >= 0 && lc->to < route_csr.n ? csr_edge_between(lc->from, lc->to, NULL, NULL) : -1;
+        if (leg >= 0) cap[leg] = lc->seats;
+    }
+    for (struct customer *c = confirmed_list.head; c; c = c->next) {
+        const struct LegPath *p = leg_path_locked(c->route_from, c->route_to, c->path_rank);
+        for (int i = 0; p && i < p->count; i++) used[p->legs[i]]++;
+    }
+    pthread_rwlock_wrlock(&legs_lock);
+    legs.cap = cap;
+    legs.used = used;
+    legs.count = count;
+    legs.version = route_graph_version;
+    pthread_rwlock_unlock(&legs_lock);
+}
+
+/* leg_path_locked() taking route_lock itself. The path stays valid while
+   state_lock is held, even if the graph is replaced meanwhile. */
+static const struct LegPath *leg_path(int from, int to, int rank) {
+    route_read_lock();
+    legs_sync_locked();
+    const struct LegPath *p = legs.version ? leg_path_locked(from, to, rank) : NULL;
+    pthread_rwlock_unlock(&route_lock);
+    return p;
+}
+
+/* 1 if leg has k free seats */
+static int legs_fit_leg(int leg, int k) {
+    return legs.cap[leg] == BACKEND_LEG_UNLIMITED || legs.used[leg] + k <= legs.cap[leg];
+}
+
+/* 1 if every leg of p has k free seats */
+static int legs_fit(const struct LegPath *p, int k) {
+    for (int i = 0; p && i < p->count; i++) {
+        if (!legs_fit_leg(p->legs[i], k)) return 0;
+    }
+    return 1;
+}
+
+/* Adds k seats (k < 0 gives them back) on every leg of p */
+static void legs_take(const struct LegPath *p, int k) {
+    if (!p) return;
+    pthread_rwlock_wrlock(&legs_lock);
+    for (int i = 0; i < p->count; i++) legs.used[p->legs[i]] += k;
+    pthread_rwlock_unlock(&legs_lock);
+}
+
+/* Price of a booking confirmed on p: a detour costs what it covers. cost if p is NULL. */
+static int legs_price(const struct LegPath *p, int cost) {
+    return p ? p->dist * PRICE_PER_UNIT : cost;
+}
+
+/* Rank of the cheapest candidate from -> to with k free seats on every leg, or
+   -1 if all are full. A pair without any path holds nothing: rank 0, *out NULL. */
+static int leg_choose(int from, int to, int k, const struct LegPath **out) {
+    int rank = 0;
+    *out = NULL;
+    route_read_lock();
+    legs_sync_locked();
+    const struct RouteChoices *rc = legs.version ? route_choices_locked(from, to) : NULL;
+    if (rc && rc->count > 0) {
+        while (rank < rc->count && !legs_fit(rc->path[rank], k)) rank++;
+        if (rank < rc->count) *out = rc->path[rank];
+        else rank = -1;
+    }
+    pthread_rwlock_unlock(&route_lock);
+    return rank;
+}
+
+/* Sets the seats of leg from - to and journals them; *old gets the previous
+   value. Caller holds state_lock and promotes the waitlist afterwards. -1 if
+   the cities are not adjacent or seats is below current use. */
+static int leg_capacity_locked(int from, int to, int seats, int *old) {
+    int rc = -1;
+    route_read_lock();
+    legs_sync_locked();
+    if (legs.version && from >= 0 && from < route_csr.n && to >= 0 && to < route_csr.n) {
+        int leg = csr_edge_between(from, to, NULL, NULL);
+        if (leg >= 0 && (seats == BACKEND_LEG_UNLIMITED || seats >= legs.used[leg]) &&
+            leg_caps_save(from, to, seats) == 0) {
+            *old = legs.cap[leg];
+            pthread_rwlock_wrlock(&legs_lock);
+            legs.cap[leg] = seats;
+            pthread_rwlock_unlock(&legs_lock);
+            if (seats == BACKEND_LEG_UNLIMITED || (*old != BACKEND_LEG_UNLIMITED && seats > *old)) wait_wake_leg(leg);
+            rc = 0;
+        }
+    }
+    pthread_rwlock_unlock(&route_lock);
+    if (rc == 0) {
+        struct LegCap lc = { from, to, seats };
+        journal_append(JREC_LEGCAP, &lc, sizeof(lc));
+    }
+    return rc;
+}
+
+int backend_set_leg_capacity(int from, int to, int seats) {
+    if (seats < BACKEND_LEG_UNLIMITED) return -1;
+    int old = BACKEND_LEG_UNLIMITED;
+    pthread_mutex_lock(&state_lock);
+    int rc = leg_capacity_locked(from, to, seats, &old);
+    if (rc == 0 && old != seats) undo_record_legcap(from, to, old, seats);
+    /* more seats can let waitlisted bookings through */
+    if (rc == 0 && promote_waitlist_local() > 0) journal_meta();
+    slots_publish();
+    pthread_mutex_unlock(&state_lock);
+    return rc;
+}
+
+/* Price of a booking from route_from to route_to; -1 if the indices are bad or
+   no path exists */
+static int booking_cost(int route_from, int route_to, int *cost) {
+    /* Validate route indices */
+    route_read_lock();
+    if (!route_graph) { pthread_rwlock_unlock(&route_lock); return -1; }
+    if (route_from < 0 || route_from >= route_graph->n || route_to < 0 || route_to >= route_graph->n) {
+        pthread_rwlock_unlock(&route_lock);
+        return -1; /* invalid indices */
+    }
+    /* Check shortest path exists and compute cost */
+    int dist = compute_route_distance_and_cost(route_from, route_to, cost);
+    pthread_rwlock_unlock(&route_lock);
+    return dist < 0 ? -1 : 0; /* no route exists */
+}
+
+/*Piyush  book/cancel/modify/search wrappers for GUI */
+int backend_book(const char *name, int age, const char *contact, int route_from, int route_to) {
+    STAT_TIMER(t0);
+    int cost = 0;
+    if (!name || !contact || booking_cost(route_from, route_to, &cost) != 0) {
+        STAT_ADD(booking_failures, 1);
+        return -1;
+    }
+
+    int reservation_id = atomic_fetch_add(&next_reservation_id, 1);
+    struct ResShard *sh = shard_of(reservation_id);
+    pthread_rwlock_wrlock(&sh->lock);
+    pthread_mutex_lock(&state_lock);
+    const struct LegPath *p;
+    int rank = leg_choose(route_from, route_to, 1, &p);
+    int legs_ok = rank >= 0;
+    /* a booking already waiting for slots keeps its place in the queue */
+    struct customer *node;
+    if (legs_ok && booked_slots < total_slots && !waitlist_blocked) {
+        cost = legs_price(p, cost);
+        node = insert_customer_local(reservation_id, name, age, contact, -1, route_from, route_to, cost);
+        if (node) {
+            node->path_rank = rank;
+            slot_take(node);
+            booked_slots++;
+            legs_take(p, 1);
+        }
+    } else {
+        node = enqueue_waitlist_local(reservation_id, name, age, contact, route_from, route_to, cost, 0);
+        if (node && legs_ok) waitlist_blocked = 1;
+    }
+    if (!node) {
+        /* out of memory: nothing was taken; hand the id back unless a later one is out */
+        int next = reservation_id + 1;
+        atomic_compare_exchange_strong(&next_reservation_id, &next, reservation_id);
+        pthread_mutex_unlock(&state_lock);
+        pthread_rwlock_unlock(&sh->lock);
+        STAT_ADD(booking_failures, 1);
+        return -1;
+    }
+    if (node->status == RES_WAITLISTED) STAT_ADD(bookings_waitlisted, 1);
+    undo_record(UNDO_BOOK, node);
+    journal_put(node);
+    journal_meta();
+    slots_publish();
+    pthread_mutex_unlock(&state_lock);
+    /* nothing reaches the record by id before the shard lock is released */
+    insertRecord(node);
+    pthread_rwlock_unlock(&sh->lock);
+    STAT_ADD(bookings, 1);
+    STAT_ELAPSED(book_ns, t0);
+    return reservation_id;
+}
+
+int backend_book_group(int k, const char *const names[], const int ages[], const char *contact, int route_from, int route_to, int ids[]) {
+    if (k < 1 || !names || !ages || !contact || !ids) return -1;
+    for (int i = 0; i < k; i++) {
+        if (!names[i]) return -1; /* the whole group or nobody */
+    }
+    int cost = 0;
+    if (booking_cost(route_from, route_to, &cost) != 0) {
+        STAT_ADD(booking_failures, 1);
+        return -1;
+    }
+
+    int first = atomic_fetch_add(&next_reservation_id, k);
+    int group_id = k > 1 ? first : 0;
+    unsigned shards = 0;
+    for (int i = 0; i < k && shards != SHARDS_ALL; i++) shards |= shard_bit(first + i);
+    shards_lock(shards);
+    pthread_mutex_lock(&state_lock);
+    if (k > total_slots) {
+        /* no run of slots could ever hold it: refuse rather than block the queue */
+        int next = first + k;
+        atomic_compare_exchange_strong(&next_reservation_id, &next, first);
+        pthread_mutex_unlock(&state_lock);
+        shards_unlock(shards);
+        STAT_ADD(booking_failures, 1);
+        return -1;
+    }
+    const struct LegPath *p;
+    int rank = leg_choose(route_from, route_to, k, &p);
+    int legs_ok = rank >= 0;
+    int s = -1, was_blocked = waitlist_blocked;
+    if (legs_ok && !waitlist_blocked && booked_slots + k <= total_slots) s = slot_find_run(k);
+    if (s > 0) {
+        legs_take(p, k);
+        cost = legs_price(p, cost);
+    } else if (legs_ok && booked_slots + k > total_slots) {
+        /* without a run of adjacent slots the group waits alone; singles still fit */
+        waitlist_blocked = 1;
+    }
+    struct CustomerList *list = s > 0 ? &confirmed_list : &waitlist;
+    int made;
+    for (made = 0; made < k; made++) {
+        ids[made] = first + made;
+        struct customer *node;
+        if (s > 0) {
+            node = insert_customer_local(ids[made], names[made], ages[made], contact, -1, route_from, route_to, cost);
+            if (node) {
+                node->path_rank = rank;
+                slot_mark(s + made, node);
+                booked_slots++;
+            }
+        } else {
+            node = enqueue_waitlist_local(ids[made], names[made], ages[made], contact, route_from, route_to, cost, group_id);
+        }
+        if (!node) break;
+        node->group_id = group_id;
+    }
+    if (made < k) {
+        /* out of memory: drop the members made so far, which are the last records
+           of their list, with the seats taken for them and the rest */
+        if (s > 0) legs_take(p, made - k);
+        while (made-- > 0) {
+            if (s > 0) delete_customer_local(list->tail);
+            else remove_waitlist_local(list->tail);
+        }
+        waitlist_blocked = was_blocked;
+        int next = first + k;
+        atomic_compare_exchange_strong(&next_reservation_id, &next, first);
+        slots_publish();
+        pthread_mutex_unlock(&state_lock);
+        shards_unlock(shards);
+        STAT_ADD(booking_failures, 1);
+        return -1;
+    }
+    /* only now does the group reach the id index, undo and the journal */
+    struct customer *node = list->tail;
+    for (int i = 1; i < k; i++) node = node->prev;
+    for (; node; node = node->next) {
+        undo_record(UNDO_BOOK, node);
+        journal_put(node);
+        insertRecord(node);
+    }
+    journal_meta();
+    slots_publish();
+    pthread_mutex_unlock(&state_lock);
+    shards_unlock(shards);
+    STAT_ADD(bookings, k);
+    if (s <= 0) STAT_ADD(bookings_waitlisted, k);
+    return s > 0 ? RES_CONFIRMED : RES_WAITLISTED;
+}
+
+/* Prices each distinct (from, to) pair of a batch once, under a single route
+   lock; cost[i] is -1 where the pair is invalid or unreachable */
+static int price_batch(const struct backend_booking *reqs, int n, int cost[]) {
+    unsigned cap = 16;
+    while (cap < (unsigned)n * 2) cap *= 2;
+    long *keys = malloc(sizeof(long) * cap);
+    int *vals = malloc(sizeof(int) * cap);
+    if (!keys || !vals) { free(keys); free(vals); return -1; }
+    for (unsigned i = 0; i < cap; i++) keys[i] = -1;
+    route_read_lock();
+    int nodes = route_graph ? route_graph->n : 0;
+    for (int i = 0; i < n; i++) {
+        int from = reqs[i].route_from, to = reqs[i].route_to;
+        cost[i] = -1;
+        if (from < 0 || from >= nodes || to < 0 || to >= nodes) continue;
+        long key = (long)from * nodes + to;
+        unsigned h = hashFunction((int)(key ^ (key >> 32))) & (cap - 1);
+        while (keys[h] != -1 && keys[h] != key) h = (h + 1) & (cap - 1);
+        if (keys[h] == -1) {
+            int c = 0;
+            keys[h] = key;
+            vals[h] = compute_route_distance_and_cost(from, to, &c) < 0 ? -1 : c;
+        }
+        cost[i] = vals[h];
+    }
+    pthread_rwlock_unlock(&route_lock);
+    free(keys);
+    free(vals);
+    return 0;
+}
+
+int backend_book_batch(const struct backend_booking *reqs, int n, int results[]) {
+    if (n < 1 || !reqs || !results) return 0;
+    int *cost = malloc(sizeof(int) * n);
+    struct DiskRecord *recs = malloc(sizeof(struct DiskRecord) * n);
+    if (!cost || !recs || price_batch(reqs, n, cost) != 0) {
+        free(cost); free(recs);
+        for (int i = 0; i < n; i++) results[i] = -1;
+        return 0;
+    }
+    int valid = 0;
+    for (int i = 0; i < n; i++) valid += cost[i] >= 0 && reqs[i].name && reqs[i].contact;
+    int first = atomic_fetch_add(&next_reservation_id, valid), next = first;
+
+    int booked = 0, waitlisted = 0;
+    unsigned shards = 0;
+    for (int i = 0; i < valid && shards != SHARDS_ALL; i++) shards |= shard_bit(first + i);
+    shards_lock(shards);
+    pthread_mutex_lock(&state_lock);
+    slab_arena_begin(&customer_pool);
+    for (int i = 0; i < n; i++) {
+        const struct backend_booking *r = &reqs[i];
+        results[i] = -1;
+        if (cost[i] < 0 || !r->name || !r->contact) continue;
+        /* an id is used up only by a record made: the unused ones are all at the end */
+        int id = next;
+        const struct LegPath *p;
+        int rank = leg_choose(r->route_from, r->route_to, 1, &p);
+        int legs_ok = rank >= 0;
+        struct customer *node;
+        if (legs_ok && booked_slots < total_slots && !waitlist_blocked) {
+            node = insert_customer_local(id, r->name, r->age, r->contact, -1, r->route_from, r->route_to, legs_price(p, cost[i]));
+            if (node) {
+                node->path_rank = rank;
+                slot_take(node);
+                booked_slots++;
+                legs_take(p, 1);
+            }
+        } else {
+            node = enqueue_waitlist_local(id, r->name, r->age, r->contact, r->route_from, r->route_to, cost[i], 0);
+            if (node && legs_ok) waitlist_blocked = 1;
+            waitlisted += node != NULL;
+        }
+        if (node) {
+            next++;
+            undo_record(UNDO_BOOK, node);
+            to_disk_record(node, &recs[booked++]);
+            insertRecord(node);
+        }
+        results[i] = node ? id : -1;
+    }
+    slab_arena_end(&customer_pool);
+    if (next < first + valid) {
+        /* out of memory for some: hand their ids back unless a later one is out */
+        int end = first + valid;
+        atomic_compare_exchange_strong(&next_reservation_id, &end, next);
+    }
+    journal_append_array(JREC_PUTS, recs, (size_t)booked, sizeof(struct DiskRecord));
+    journal_meta();
+    slots_publish();
+    pthread_mutex_unlock(&state_lock);
+    shards_unlock(shards);
+    STAT_ADD(bookings, booked);
+    STAT_ADD(bookings_waitlisted, waitlisted);
+    STAT_ADD(booking_failures, n - booked);
+    free(cost);
+    free(recs);
+    return booked;
+}
+
+/* Takes record id out of the index ahead of cancel_record_locked(). Caller
+   holds its shard lock exclusively. NULL if the id is unknown. */
+static struct customer *unindex_record(int id) {
+    struct customer *c = searchRecord(id);
+    if (c) deleteRecord(id);
+    return c;
+}
+
+/* Drops record c, already out of the index, and journals it; *was gets the
+   record as it was. Caller holds state_lock and promotes the waitlist
+   afterwards. */
+static void cancel_record_locked(struct customer *c, struct customer *was) {
+    if (was) *was = *c;
+    journal_del(c->reservation_id);
+    if (c->status != RES_WAITLISTED) delete_customer_local(c);
+    else remove_waitlist_local(c);
+}
+
+/* Books r again under its old id, the way a new booking would be: confirmed if a
+   slot and seats on some candidate path are free, in its old slot if that is
+   still free, and waitlisted otherwise. Caller holds the id's shard lock
+   exclusively and state_lock. 0 if the id is in use again. */
+static int restore_record_locked(const struct customer *r) {
+    if (searchRecord(r->reservation_id)) return 0;
+    const struct LegPath *p;
+    int rank = leg_choose(r->route_from, r->route_to, 1, &p);
+    struct customer *node;
+    if (rank >= 0 && booked_slots < total_slots && !waitlist_blocked) {
+        node = insert_customer_local(r->reservation_id, r->name, r->age, r->contact, -1, r->route_from, r->route_to, legs_price(p, r->cost));
+        if (node) {
+            node->path_rank = rank;
+            int s = r->slot_number;
+            if (s >= 1 && s <= total_slots && !slot_owner[s - 1]) slot_mark(s, node);
+            else slot_take(node);
+            booked_slots++;
+            legs_take(p, 1);
+        }
+    } else {
+        node = enqueue_waitlist_local(r->reservation_id, r->name, r->age, r->contact, r->route_from, r->route_to, r->cost, r->group_id);
+        if (rank >= 0) waitlist_blocked = 1;
+    }
+    if (node) node->group_id = r->group_id;
+    journal_put(node);
+    insertRecord(node);
+    return node != NULL;
+}
+
+void backend_cancel(int reservation_id) {
+    STAT_TIMER(t0);
+    struct customer was;
+    struct ResShard *sh = shard_of(reservation_id);
+    pthread_rwlock_wrlock(&sh->lock);
+    struct customer *c = unindex_record(reservation_id);
+    if (!c) {
+        pthread_rwlock_unlock(&sh->lock);
+        STAT_ADD(cancel_misses, 1);
+        return;
+    }
+    pthread_mutex_lock(&state_lock);
+    cancel_record_locked(c, &was);
+    undo_record(UNDO_CANCEL, &was);
+    /* a waitlisted group may have been holding back those queued behind it */
+    int promoted = promote_waitlist_local();
+    STAT_ADD(promotions, promoted);
+    journal_meta();
+    slots_publish();
+    pthread_mutex_unlock(&state_lock);
+    pthread_rwlock_unlock(&sh->lock);
+    STAT_ADD(cancels, 1);
+    STAT_ELAPSED(cancel_ns, t0);
+}
+
+int backend_cancel_batch(const int ids[], int n, int results[]) {
+    if (n < 1 || !ids || !results) return 0;
+    int32_t *gone = malloc(sizeof(int32_t) * n);
+    if (!gone) {
+        for (int i = 0; i < n; i++) results[i] = 0;
+        return 0;
+    }
+    int cancelled = 0;
+    unsigned shards = 0;
+    for (int i = 0; i < n && shards != SHARDS_ALL; i++) shards |= shard_bit(ids[i]);
+    shards_lock(shards);
+    pthread_mutex_lock(&state_lock);
+    for (int i = 0; i < n; i++) {
+        struct customer *c = unindex_record(ids[i]);
+        results[i] = c != NULL;
+        if (c) {
+            gone[cancelled++] = ids[i];
+            undo_record(UNDO_CANCEL, c);
+            if (c->status != RES_WAITLISTED) delete_customer_local(c);
+            else remove_waitlist_local(c);
+        }
+    }
+    journal_append_array(JREC_DELS, gone, (size_t)cancelled, sizeof(int32_t));
+    int promoted = promote_waitlist_local();
+    journal_meta();
+    slots_publish();
+    pthread_mutex_unlock(&state_lock);
+    shards_unlock(shards);
+    STAT_ADD(cancels, cancelled);
+    STAT_ADD(cancel_misses, n - cancelled);
+    STAT_ADD(promotions, promoted);
+    free(gone);
+    return cancelled;
+}
+
+/* Sets the fields of record id that are given (NULL name/contact and age <= 0
+   keep the old value) and journals it; *was gets the record as it was. Caller
+   holds the id's shard lock and state_lock. 0 if the id is unknown. */
+static int modify_record_locked(int id, const char *name, int age, const char *contact, struct customer *was) {
+    struct customer *temp = searchRecord(id);
+    if (temp) {
+        if (was) *was = *temp;
+        lookup_remove(temp);
+        if (name) strncpy(temp->name, name, sizeof(temp->name)-1);
+        if (age > 0) temp->age = age;
+        if (contact) strncpy(temp->contact, contact, sizeof(temp->contact)-1);
+        lookup_add(temp);
+        journal_put(temp);
+    }
+    return temp != NULL;
+}
+
+void backend_modify(int reservation_id, const char *newname, int newage, const char *newcontact) {
+    /* empty strings keep the old value */
+    if (newname && !newname[0]) newname = NULL;
+    if (newcontact && !newcontact[0]) newcontact = NULL;
+    struct customer was;
+    struct ResShard *sh = shard_of(reservation_id);
+    pthread_rwlock_rdlock(&sh->lock);
+    pthread_mutex_lock(&state_lock);
+    if (modify_record_locked(reservation_id, newname, newage, newcontact, &was)) {
+        undo_record_modify(&was, newname, newage, newcontact);
+    }
+    pthread_mutex_unlock(&state_lock);
+    pthread_rwlock_unlock(&sh->lock);
+}
+
+/* Lock-free for ids in the direct range; hash-indexed ids take the shard lock */
+int backend_search(int reservation_id) {
+    struct ResShard *sh = shard_of(reservation_id);
+    int page, off;
+    struct EpochReader *r = direct_slot(reservation_id, &page, &off) ? epoch_reader() : NULL;
+    if (r) {
+        STAT_ADD(lookups_direct, 1);
+        epoch_enter(r);
+        struct DirectPage *pg = direct_page_get(sh, page, 0);
+        struct customer *found = pg ? atomic_load_explicit(&pg->rec[off], memory_order_acquire) : NULL;
+        int status = found ? atomic_load(&found->status) : 0;
+        epoch_exit(r);
+        return status;
+    }
+    pthread_rwlock_rdlock(&sh->lock);
+    struct customer *found = searchRecord(reservation_id);
+    int status = found ? found->status : 0; /* 1 = confirmed, 2 = waitlist */
+    pthread_rwlock_unlock(&sh->lock);
+    return status;
+}
+
+/* Moves record id to from -> to at cost (the price of the shortest path) and
+   journals it; *was gets the record as it was. Caller holds the id's shard lock
+   and state_lock. 0 if the id is unknown or a confirmed record found every new
+   path full. */
+static int assign_route_locked(int id, int from, int to, int cost, struct customer *was) {
+    struct customer *c = searchRecord(id);
+    if (c && was) *was = *c;
+    if (c && c->status == RES_CONFIRMED) {
+        /* a confirmed booking moves its leg seats, or keeps its route if every new path is full */
+        const struct LegPath *old = leg_path(c->route_from, c->route_to, c->path_rank);
+        const struct LegPath *p;
+        legs_take(old, -1);
+        int rank = leg_choose(from, to, 1, &p);
+        if (rank < 0) {
+            legs_take(old, 1);
+            c = NULL;
+        } else {
+            legs_take(p, 1);
+            wait_wake_path(old);
+            c->path_rank = rank;
+            cost = legs_price(p, cost);
+        }
+    }
+    if (c) {
+        route_index_remove(c);
+        c->route_from = from; c->route_to = to; c->cost = cost;
+        route_index_add(c);
+        journal_put(c);
+    }
+    return c != NULL;
+}
+
+void backend_assign_route(int id, int from, int to) {
+    /* Attempt to compute cost and assign only if path exists */
+    route_read_lock();
+    int cost = 0;
+    int dist = -1;
+    if (route_graph && from >= 0 && from < route_graph->n && to >= 0 && to < route_graph->n) {
+        dist = compute_route_distance_and_cost(from, to, &cost);
+    }
+    pthread_rwlock_unlock(&route_lock);
+    if (dist < 0) {
+        /* invalid route -> do nothing */
+        return;
+    }
+    struct customer was;
+    struct ResShard *sh = shard_of(id);
+    pthread_rwlock_rdlock(&sh->lock);
+    pthread_mutex_lock(&state_lock);
+    if (assign_route_locked(id, from, to, cost, &was)) undo_record_route(&was, from, to, cost);
+    pthread_mutex_unlock(&state_lock);
+    pthread_rwlock_unlock(&sh->lock);
+}
+
+/* ----------------- WAITLIST INDEX ----------------- */
+/* Promotion order without a walk over the waitlist. Waitlisted records are kept
+   in units: the single bookings of one (from, to) pair, which share their
+   candidate paths and so fit or not together and move one at a time, or one
+   group booking (or a record without a route) on its own. A unit that may be
+   able to move sits in a min-heap on the list_seq of its first record, so units
+   come out in FIFO order. One that found every candidate path with a full leg is
+   parked until seats come free: a pair unit on the first full leg of each path,
+   anything else on all legs at once. Freeing seats wakes the units parked on
+   those legs, so a promotion pass only looks at units that could move. Built on
+   the first promotion after a load, rebuilt whenever the leg counters are, and
+   kept up to date by the route index. Runs under state_lock. */
+struct ParkLink {
+    struct WaitUnit *unit;
+    int leg; /* -1 = parked on every leg */
+    struct ParkLink *next;
+    struct ParkLink *prev;
+};
+
+struct WaitUnit {
+    struct RoutePair *pair;    /* NULL for a group or a record without a route */
+    struct customer *head;     /* records in list_seq order through wait_next/wait_prev */
+    struct customer *tail;
+    int count;
+    int heap_pos;              /* -1 when not in the heap */
+    int parked;                /* links in use */
+    struct ParkLink link[ROUTE_CHOICES];
+    struct WaitUnit *all_next; /* every unit, for wait_index_reset */
+    struct WaitUnit *all_prev;
+    struct WaitUnit *passed;   /* groups passed over by the running promotion */
+};
+
+static struct {
+    int ready;
+    unsigned version;           /* legs.version the parked units were checked against */
+    struct WaitUnit **heap;
+    int heap_count;
+    int heap_cap;
+    int units;
+    struct WaitUnit *all;
+    struct ParkLink **on_leg;   /* per leg */
+    int legs;
+    struct ParkLink *on_any;
+} wait_index;
+
+static unsigned long wait_key(const struct WaitUnit *u) {
+    return u->head->list_seq;
+}
+
+static void wait_heap_set(int i, struct WaitUnit *u) {
+    wait_index.heap[i] = u;
+    u->heap_pos = i;
+}
+
+static void wait_heap_fix(struct WaitUnit *u) {
+    int i = u->heap_pos;
+    while (i > 0 && wait_key(wait_index.heap[(i - 1) / 2]) > wait_key(u)) {
+        wait_heap_set(i, wait_index.heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= wait_index.heap_count) break;
+        if (c + 1 < wait_index.heap_count && wait_key(wait_index.heap[c + 1]) < wait_key(wait_index.heap[c])) c++;
+        if (wait_key(wait_index.heap[c]) >= wait_key(u)) break;
+        wait_heap_set(i, wait_index.heap[c]);
+        i = c;
+    }
+    wait_heap_set(i, u);
+}
+
+/* heap_cap never falls below the number of units, so this cannot fail */
+static void wait_heap_push(struct WaitUnit *u) {
+    wait_heap_set(wait_index.heap_count++, u);
+    wait_heap_fix(u);
+}
+
+static void wait_heap_remove(struct WaitUnit *u) {
+    struct WaitUnit *last = wait_index.heap[--wait_index.heap_count];
+    int i = u->heap_pos;
+    u->heap_pos = -1;
+    if (last == u) return;
+    wait_heap_set(i, last);
+    wait_heap_fix(last);
+}
+
+static void wait_unpark(struct WaitUnit *u) {
+    for (int i = 0; i < u->parked; i++) {
+        struct ParkLink *l = &u->link[i];
+        if (l->prev) l->prev->next = l->next;
+        else if (l->leg < 0) wait_index.on_any = l->next;
+        else wait_index.on_leg[l->leg] = l->next;
+        if (l->next) l->next->prev = l->prev;
+    }
+    u->parked = 0;
+}
+
+static void wait_park_on(struct WaitUnit *u, int leg) {
+    struct ParkLink *l = &u->link[u->parked++];
+    struct ParkLink **head = leg < 0 ? &wait_index.on_any : &wait_index.on_leg[leg];
+    l->unit = u;
+    l->leg = leg;
+    l->prev = NULL;
+    l->next = *head;
+    if (*head) (*head)->prev = l;
+    *head = l;
+}
+
+/* Parks u, just found with no candidate path that has room for its first record */
+static void wait_park(struct WaitUnit *u) {
+    int full[ROUTE_CHOICES], n = 0;
+    if (u->pair) {
+        route_read_lock();
+        const struct RouteChoices *rc = legs.version ? route_choices_locked(u->pair->from, u->pair->to) : NULL;
+        for (int r = 0; rc && r < rc->count; r++) {
+            const struct LegPath *p = rc->path[r];
+            int i = 0;
+            while (i < p->count && legs_fit_leg(p->legs[i], 1)) i++;
+            if (i == p->count) { n = 0; break; }
+            int j = 0;
+            while (j < n && full[j] != p->legs[i]) j++;
+            if (j == n) full[n++] = p->legs[i];
+        }
+        pthread_rwlock_unlock(&route_lock);
+    }
+    for (int i = 0; i < n; i++) {
+        if (full[i] < wait_index.legs) wait_park_on(u, full[i]);
+    }
+    if (u->parked < n || n == 0) {
+        wait_unpark(u);
+        wait_park_on(u, -1);
+    }
+}
+
+static void wait_wake_list(struct ParkLink **list) {
+    while (*list) {
+        struct WaitUnit *u = (*list)->unit;
+        wait_unpark(u);
+        wait_heap_push(u);
+    }
+}
+
+/* Seats came free on leg */
+static void wait_wake_leg(int leg) {
+    if (!wait_index.ready || wait_index.version != legs.version) return; /* rebuilt before the next promotion */
+    if (leg >= 0 && leg < wait_index.legs) wait_wake_list(&wait_index.on_leg[leg]);
+    wait_wake_list(&wait_index.on_any);
+}
+
+static void wait_wake_path(const struct LegPath *p) {
+    for (int i = 0; p && i < p->count; i++) wait_wake_leg(p->legs[i]);
+}
+
+static struct WaitUnit *wait_unit_new(struct RoutePair *pair) {
+    if (wait_index.units == wait_index.heap_cap) {
+        int cap = wait_index.heap_cap ? wait_index.heap_cap * 2 : 64;
+        struct WaitUnit **heap = realloc(wait_index.heap, sizeof(*heap) * cap);
+        if (!heap) return NULL;
+        wait_index.heap = heap;
+        wait_index.heap_cap = cap;
+    }
+    struct WaitUnit *u = calloc(1, sizeof(*u));
+    if (!u) return NULL;
+    u->pair = pair;
+    u->heap_pos = -1;
+    u->all_next = wait_index.all;
+    if (wait_index.all) wait_index.all->all_prev = u;
+    wait_index.all = u;
+    wait_index.units++;
+    return u;
+}
+
+static void wait_unit_free(struct WaitUnit *u) {
+    if (u->all_prev) u->all_prev->all_next = u->all_next;
+    else wait_index.all = u->all_next;
+    if (u->all_next) u->all_next->all_prev = u->all_prev;
+    wait_index.units--;
+    free(u);
+}
+
+/* Drops the whole index; records keep stale wait_unit pointers until the next build */
+static void wait_index_reset() {
+    while (wait_index.all) {
+        struct WaitUnit *u = wait_index.all;
+        if (u->pair) u->pair->wait = NULL;
+        wait_unit_free(u);
+    }
+    free(wait_index.heap);
+    free(wait_index.on_leg);
+    memset(&wait_index, 0, sizeof(wait_index));
+}
+
+/* Called by route_index_add for a waitlisted record already in the waitlist */
+static void wait_index_add(struct customer *c) {
+    c->wait_unit = NULL;
+    if (!wait_index.ready) return;
+    struct WaitUnit *u = NULL;
+    if (!c->group_id && c->route_pair) {
+        u = c->route_pair->wait;
+        if (!u) u = c->route_pair->wait = wait_unit_new(c->route_pair);
+    } else {
+        /* a group is a run of neighbours with the same group_id */
+        struct customer *n = c->prev && c->group_id && c->prev->group_id == c->group_id ? c->prev :
+                             c->next && c->group_id && c->next->group_id == c->group_id ? c->next : NULL;
+        u = n && n->wait_unit && !n->wait_unit->pair ? n->wait_unit : wait_unit_new(NULL);
+    }
+    if (!u) { wait_index_reset(); return; }
+    struct customer *at = u->tail;
+    while (at && at->list_seq > c->list_seq) at = at->wait_prev;
+    c->wait_prev = at;
+    c->wait_next = at ? at->wait_next : u->head;
+    if (c->wait_next) c->wait_next->wait_prev = c;
+    else u->tail = c;
+    if (at) at->wait_next = c;
+    else u->head = c;
+    c->wait_unit = u;
+    if (u->count++ == 0) wait_heap_push(u);
+    else if (u->heap_pos >= 0 && u->head == c) wait_heap_fix(u);
+}
+
+/* Called by route_index_remove for a waitlisted record */
+static void wait_index_remove(struct customer *c) {
+    struct WaitUnit *u = c->wait_unit;
+    if (!wait_index.ready || !u) return;
+    if (c->wait_prev) c->wait_prev->wait_next = c->wait_next;
+    else u->head = c->wait_next;
+    if (c->wait_next) c->wait_next->wait_prev = c->wait_prev;
+    else u->tail = c->wait_prev;
+    c->wait_unit = NULL;
+    if (--u->count == 0) {
+        if (u->heap_pos >= 0) wait_heap_remove(u);
+        wait_unpark(u);
+        if (!u->pair) wait_unit_free(u);
+    } else if (u->heap_pos >= 0) {
+        wait_heap_fix(u);
+    } else if (u->parked && !u->pair) {
+        /* a smaller group may fit */
+        wait_unpark(u);
+        wait_heap_push(u);
+    }
+}
+
+/* Builds the index if there is none or the leg counters were rebuilt since */
+static int wait_index_sync() {
+    route_read_lock();
+    legs_sync_locked();
+    unsigned version = legs.version;
+    int count = legs.count;
+    pthread_rwlock_unlock(&route_lock);
+    if (wait_index.ready && wait_index.version == version) return 0;
+    wait_index_reset();
+    wait_index.on_leg = calloc(count > 0 ? count : 1, sizeof(*wait_index.on_leg));
+    if (!wait_index.on_leg) return -1;
+    wait_index.legs = count;
+    wait_index.version = version;
+    wait_index.ready = 1;
+    for (struct customer *c = waitlist.head; c; c = c->next) c->wait_unit = NULL;
+    for (struct customer *c = waitlist.head; c && wait_index.ready; c = c->next) wait_index_add(c);
+    return wait_index.ready ? 0 : -1;
+}
+
+/* Gives back the seats legs_take_unit() took for the first k records from h */
+static void legs_give_unit(struct customer *h, int k) {
+    for (; k > 0; k--, h = h->wait_next) legs_take(leg_path(h->route_from, h->route_to, h->path_rank), -1);
+}
+
+/* Takes a seat for each of the first k records from h, each on the cheapest of
+   its own candidate paths with room, since assign_route can move one group
+   member; all or nothing. The chosen rank is kept in the record. */
+static int legs_take_unit(struct customer *h, int k) {
+    struct customer *m = h;
+    int i;
+    for (i = 0; i < k; i++, m = m->wait_next) {
+        const struct LegPath *p;
+        int rank = leg_choose(m->route_from, m->route_to, 1, &p);
+        if (rank < 0) break;
+        legs_take(p, 1);
+        m->path_rank = rank;
+    }
+    if (i == k) return 1;
+    legs_give_unit(h, i);
+    return 0;
+}
+
+/* Confirms waitlisted bookings in FIFO order, taking units off the heap. A group
+   counts as one booking and needs as many adjacent slots as it has members. A
+   unit whose candidate paths all have a full leg is parked, since the seats
+   freed elsewhere are of no use to it, and a group with enough free slots but
+   no adjacent run of them is passed over: only the group waits for one, as is
+   a group larger than total_slots, left waiting by change_slots. The first
+   booking short of free slots ends the pass and sets waitlist_blocked, so
+   new bookings queue behind it. Records move lists in place, so index entries
+   stay valid and no shard lock is needed. Caller holds state_lock. Returns the number of
+   records promoted; none if the index cannot be built for lack of memory. */
+static int promote_waitlist_local() {
+    int promoted = 0;
+    struct WaitUnit *passed = NULL;
+    waitlist_blocked = 0;
+    if (wait_index_sync() != 0) return 0;
+    while (wait_index.heap_count > 0) {
+        struct WaitUnit *u = wait_index.heap[0];
+        struct customer *h = u->head;
+        int single = u->pair != NULL, k = single ? 1 : u->count;
+        wait_heap_remove(u);
+        if (k > total_slots) {
+            u->passed = passed;
+            passed = u;
+            continue;
+        }
+        if (!legs_take_unit(h, k)) {
+            wait_park(u);
+            continue;
+        }
+        int s = -1;
+        if (booked_slots + k <= total_slots) s = k == 1 ? slot_find_free() : slot_find_run(k);
+        if (s < 1 || s + k - 1 > total_slots) {
+            legs_give_unit(h, k);
+            if (booked_slots + k <= total_slots) {
+                u->passed = passed;
+                passed = u;
+                continue;
+            }
+            wait_heap_push(u);
+            waitlist_blocked = 1;
+            break;
+        }
+        /* the last record out frees a group's unit */
+        for (int i = 0; i < k; i++) {
+            struct customer *c = h;
+            h = h->wait_next;
+            list_unlink(&waitlist, c);
+            route_index_remove(c);
+            c->status = RES_CONFIRMED;
+            c->cost = legs_price(leg_path(c->route_from, c->route_to, c->path_rank), c->cost);
+            route_index_add(c);
+            slot_mark(s + i, c);
+            booked_slots++;
+            list_append(&confirmed_list, c);
+            journal_put(c);
+        }
+        promoted += k;
+        if (single && u->count > 0) wait_heap_push(u);
+    }
+    while (passed) {
+        struct WaitUnit *u = passed;
+        passed = u->passed;
+        wait_heap_push(u);
+    }
+    return promoted;
+}
+
+/* Helper safe append */
+static void append_safe(char *buf, int *pos, int size, const char *fmt, ...) {
+    if (*pos >= size-1) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int r = vsnprintf(buf + *pos, size - *pos, fmt, ap);
+    va_end(ap);
+    if (r > 0) *pos += r;
+    if (*pos > size-1) *pos = size-1;
+}
+
+/* ----------------- LISTING CURSORS ----------------- */
+/* A backend_cursor remembers where the last call stopped, so a listing can be
+   fetched a page at a time with the locks held only during each call. For the
+   two lists it holds the id and list_seq of the last record returned and of
+   the one after it: records only join a list at the tail with a larger
+   list_seq, so the walk resumes right after the first if it is still there, or
+   at the second, each one index lookup. Only if both are gone does it skip from
+   the head to the first larger list_seq. The slot map resumes at a slot
+   number. */
+#define CURSOR_CHUNK_BYTES (16 * 1024) /* text formatted per call by backend_write_list */
+
+/* One locked pass over a cursor: peek at the row it points to, then step past it */
+struct CursorWalk {
+    struct backend_cursor *cur;
+    struct customer *next; /* lists: record to return next, NULL at the end */
+};
+
+/* Caller holds records_read_lock() */
+static void cursor_start_locked(struct CursorWalk *w, struct backend_cursor *cur) {
+    const struct CustomerList *l = cur->list == BACKEND_LIST_WAITLIST ? &waitlist : &confirmed_list;
+    w->cur = cur;
+    w->next = NULL;
+    if (cur->list == BACKEND_LIST_SLOTS) return;
+    int status = cur->list == BACKEND_LIST_WAITLIST ? RES_WAITLISTED : RES_CONFIRMED;
+    struct customer *c = cur->seq ? searchRecord(cur->id) : NULL;
+    if (c && c->list_seq == cur->seq && c->status == status) {
+        w->next = c->next;
+        return;
+    }
+    c = cur->next_seq ? searchRecord(cur->next_id) : NULL;
+    if (c && c->list_seq == cur->next_seq && c->status == status) {
+        w->next = c;
+        return;
+    }
+    for (c = l->head; c && c->list_seq <= cur->seq; c = c->next) {}
+    w->next = c;
+}
+
+static void cursor_fill(struct backend_record *out, const struct customer *c) {
+    out->reservation_id = c->reservation_id;
+    memcpy(out->name, c->name, sizeof(out->name));
+    out->age = c->age;
+    memcpy(out->contact, c->contact, sizeof(out->contact));
+    out->slot_number = c->slot_number;
+    out->route_from = c->route_from;
+    out->route_to = c->route_to;
+    out->cost = c->cost;
+    out->group_id = c->group_id;
+    out->status = c->status;
+}
+
+/* Fills out with the row at the walk's position; 0 at the end */
+static int cursor_peek(const struct CursorWalk *w, struct backend_record *out) {
+    if (w->cur->list != BACKEND_LIST_SLOTS) {
+        if (!w->next) return 0;
+        cursor_fill(out, w->next);
+        return 1;
+    }
+    int slot = w->cur->slot;
+    if (slot < 1 || slot > total_slots) return 0;
+    const struct customer *c = slot_owner[slot - 1];
+    if (c) {
+        cursor_fill(out, c);
+    } else {
+        memset(out, 0, sizeof(*out));
+        out->route_from = out->route_to = -1;
+    }
+    out->slot_number = slot;
+    return 1;
+}
+
+static void cursor_step(struct CursorWalk *w) {
+    if (w->cur->list == BACKEND_LIST_SLOTS) {
+        w->cur->slot++;
+        return;
+    }
+    w->cur->id = w->next->reservation_id;
+    w->cur->seq = w->next->list_seq;
+    w->next = w->next->next;
+    w->cur->next_id = w->next ? w->next->reservation_id : 0;
+    w->cur->next_seq = w->next ? w->next->list_seq : 0;
+}
+
+/* The line backend_get_*_text prints for r; returns its length like snprintf */
+static int cursor_format(char *line, int size, int list, const struct backend_record *r) {
+    int pos = 0;
+    if (list == BACKEND_LIST_SLOTS) {
+        if (r->reservation_id) append_safe(line, &pos, size, "Slot %d - %s (ID:%d)\n", r->slot_number, r->name, r->reservation_id);
+        else append_safe(line, &pos, size, "Slot %d - Available\n", r->slot_number);
+        return pos;
+    }
+    append_safe(line, &pos, size, "ID:%d | %s | Age:%d | Contact:%s", r->reservation_id, r->name, r->age, r->contact);
+    if (list == BACKEND_LIST_CONFIRMED) append_safe(line, &pos, size, " | Slot:%d", r->slot_number);
+    if (r->group_id) append_safe(line, &pos, size, " | Group:%d", r->group_id);
+    if (r->route_from != -1 || r->route_to != -1) {
+        char a[16], b[16];
+        const char *from = city_name_local(r->route_from, a, sizeof(a));
+        const char *to   = city_name_local(r->route_to, b, sizeof(b));
+        append_safe(line, &pos, size, " | Route:%s->%s | Cost:₹%d", from, to, r->cost);
+    }
+    append_safe(line, &pos, size, "\n");
+    return pos;
+}
+
+/* Appends whole lines from the walk to buf while they fit; returns the rows written */
+static int cursor_text_locked(struct CursorWalk *w, int max_rows, char *buf, int *pos, int bufsize) {
+    char line[256];
+    struct backend_record r;
+    int rows = 0;
+    while (rows < max_rows && cursor_peek(w, &r)) {
+        int len = cursor_format(line, sizeof(line), w->cur->list, &r);
+        if (*pos + len >= bufsize) break;
+        memcpy(buf + *pos, line, len);
+        *pos += len;
+        cursor_step(w);
+        rows++;
+    }
+    buf[*pos] = '\0';
+    return rows;
+}
+
+void backend_cursor_init(struct backend_cursor *cur, int list) {
+    memset(cur, 0, sizeof(*cur));
+    cur->list = list;
+    cur->slot = 1;
+}
+
+int backend_cursor_next(struct backend_cursor *cur, struct backend_record out[], int max) {
+    if (!cur || !out || cur->list < BACKEND_LIST_CONFIRMED || cur->list > BACKEND_LIST_SLOTS) return 0;
+    struct CursorWalk w;
+    int n = 0;
+    records_read_lock();
+    cursor_start_locked(&w, cur);
+    while (n < max && cursor_peek(&w, &out[n])) {
+        cursor_step(&w);
+        n++;
+    }
+    records_read_unlock();
+    return n;
+}
+
+int backend_cursor_text(struct backend_cursor *cur, int max_rows, char *buf, int bufsize) {
+    if (!buf || bufsize <= 0) return 0;
+    buf[0] = '\0';
+    if (!cur || cur->list < BACKEND_LIST_CONFIRMED || cur->list > BACKEND_LIST_SLOTS) return 0;
+    struct CursorWalk w;
+    int pos = 0;
+    records_read_lock();
+    cursor_start_locked(&w, cur);
+    int rows = cursor_text_locked(&w, max_rows, buf, &pos, bufsize);
+    records_read_unlock();
+    return rows;
+}
+
+int backend_write_list(int list, backend_writer write, void *ctx) {
+    if (!write || list < BACKEND_LIST_CONFIRMED || list > BACKEND_LIST_SLOTS) return -1;
+    char *chunk = malloc(CURSOR_CHUNK_BYTES);
+    if (!chunk) return -1;
+    struct backend_cursor cur;
+    backend_cursor_init(&cur, list);
+    int rc = 0, rows, total = 0;
+    /* the locks are dropped while write runs, so a slow reader stalls nobody */
+    while ((rows = backend_cursor_text(&cur, INT_MAX, chunk, CURSOR_CHUNK_BYTES)) > 0) {
+        total += rows;
+        if (write(ctx, chunk, (int)strlen(chunk)) != 0) { rc = -1; break; }
+    }
+    if (rc == 0 && total == 0 && list != BACKEND_LIST_SLOTS) {
+        const char *empty = list == BACKEND_LIST_CONFIRMED ? "No confirmed reservations.\n" : "Waitlist empty.\n";
+        if (write(ctx, empty, (int)strlen(empty)) != 0) rc = -1;
+    }
+    free(chunk);
+    return rc;
+}
+
+int backend_list_size(int list) {
+    int n = 0;
+    pthread_mutex_lock(&state_lock);
+    if (list == BACKEND_LIST_CONFIRMED) n = confirmed_list.count;
+    else if (list == BACKEND_LIST_WAITLIST) n = waitlist.count;
+    else if (list == BACKEND_LIST_SLOTS) n = total_slots;
+    pthread_mutex_unlock(&state_lock);
+    return n;
+}
+
+void backend_get_confirmed_text(char *buf, int bufsize) {
+    int pos = 0;
+    records_read_lock();
+    if (!confirmed_list.head) {
+        records_read_unlock();
+        append_safe(buf, &pos, bufsize, "No confirmed reservations.\n");
+        buf[pos]='\0';
+        return;
+    }
+    struct backend_cursor cur;
+    struct CursorWalk w;
+    backend_cursor_init(&cur, BACKEND_LIST_CONFIRMED);
+    cursor_start_locked(&w, &cur);
+    cursor_text_locked(&w, INT_MAX, buf, &pos, bufsize);
+    records_read_unlock();
+}
+
+void backend_get_waitlist_text(char *buf, int bufsize) {
+    int pos = 0;
+    records_read_lock();
+    if (!waitlist.head) { records_read_unlock(); append_safe(buf, &pos, bufsize, "Waitlist empty.\n"); buf[pos]='\0'; return; }
+    struct backend_cursor cur;
+    struct CursorWalk w;
+    backend_cursor_init(&cur, BACKEND_LIST_WAITLIST);
+    cursor_start_locked(&w, &cur);
+    cursor_text_locked(&w, INT_MAX, buf, &pos, bufsize);
+    records_read_unlock();
+}
+
+void backend_get_slotmap_text(char *buf, int bufsize) {
+    int pos = 0;
+    struct backend_cursor cur;
+    struct CursorWalk w;
+    backend_cursor_init(&cur, BACKEND_LIST_SLOTS);
+    records_read_lock();
+    cursor_start_locked(&w, &cur);
+    cursor_text_locked(&w, INT_MAX, buf, &pos, bufsize);
+    records_read_unlock();
+}
+
+void backend_get_legs_text(char *buf, int bufsize) {
+    int pos = 0;
+    pthread_mutex_lock(&state_lock);
+    route_read_lock();
+    legs_sync_locked();
+    for (int u = 0; legs.version && u < route_csr.n; u++) {
+        for (int k = route_csr.offset[u]; k < route_csr.offset[u + 1]; k++) {
+            int v = route_csr.target[k], leg = route_csr.leg[k];
+            /* each leg once, from its lower-numbered city */
+            if (v < u || csr_edge_between(u, v, NULL, NULL) != leg) continue;
+            append_safe(buf, &pos, bufsize, "%s - %s: %d booked",
+                        u < CITY_COUNT ? CityName[u] : "City", v < CITY_COUNT ? CityName[v] : "City", legs.used[leg]);
+            if (u >= CITY_COUNT || v >= CITY_COUNT) append_safe(buf, &pos, bufsize, " (%d-%d)", u, v);
+            if (legs.cap[leg] == BACKEND_LEG_UNLIMITED) append_safe(buf, &pos, bufsize, ", unlimited\n");
+            else append_safe(buf, &pos, bufsize, " of %d\n", legs.cap[leg]);
+        }
+    }
+    pthread_rwlock_unlock(&route_lock);
+    pthread_mutex_unlock(&state_lock);
+    buf[pos]='\0';
+}
+
+/* Reservation id holding slot, 0 if the slot is free or out of range */
+int backend_get_slot_owner(int slot) {
+    int id = 0;
+    pthread_mutex_lock(&state_lock);
+    if (slot >= 1 && slot <= total_slots && slot_owner[slot-1]) id = slot_owner[slot-1]->reservation_id;
+    pthread_mutex_unlock(&state_lock);
+    return id;
+}
+
+void backend_get_availability_text(char *buf, int bufsize) {
+    int pos = 0;
+    int total, booked;
+    slots_read(&total, &booked);
+    append_safe(buf, &pos, bufsize, "Total: %d\nBooked: %d\nAvailable: %d\n", total, booked, total - booked);
+    buf[pos]='\0';
+}
+
+void backend_get_stats(struct backend_stats *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+#ifndef BACKEND_NO_STATS
+#define STATS_COPY(name) out->name = atomic_load_explicit(&stats.name, memory_order_relaxed);
+#define STATS_HIST_COPY(name) \
+    for (int i = 0; i < BACKEND_STATS_BUCKETS; i++) out->name[i] = atomic_load_explicit(&stats.name[i], memory_order_relaxed);
+    STATS_COUNTERS(STATS_COPY)
+    STATS_HISTOGRAMS(STATS_HIST_COPY)
+#endif
+}
+
+#ifndef BACKEND_NO_STATS
+/* Upper bound of the bucket holding the p-th fraction of a histogram */
+static unsigned long stats_percentile(const unsigned long *h, double p) {
+    unsigned long total = 0, seen = 0;
+    for (int i = 0; i < BACKEND_STATS_BUCKETS; i++) total += h[i];
+    if (total == 0) return 0;
+    for (int i = 0; i < BACKEND_STATS_BUCKETS; i++) {
+        seen += h[i];
+        if ((double)seen >= p * (double)total) return (2UL << i) - 1;
+    }
+    return ~0UL;
+}
+#endif
+
+void backend_get_stats_text(char *buf, int bufsize) {
+    int pos = 0;
+#ifdef BACKEND_NO_STATS
+    append_safe(buf, &pos, bufsize, "Statistics disabled (built with BACKEND_NO_STATS)\n");
+#else
+    struct backend_stats s;
+    backend_get_stats(&s);
+    append_safe(buf, &pos, bufsize, "Bookings: %lu (waitlisted %lu, failed %lu) | p50 <%luns p99 <%luns\n",
+                s.bookings, s.bookings_waitlisted, s.booking_failures,
+                stats_percentile(s.book_ns, 0.50), stats_percentile(s.book_ns, 0.99));
+    append_safe(buf, &pos, bufsize, "Cancels: %lu (promotions %lu, unknown id %lu) | p50 <%luns p99 <%luns\n",
+                s.cancels, s.promotions, s.cancel_misses,
+                stats_percentile(s.cancel_ns, 0.50), stats_percentile(s.cancel_ns, 0.99));
+    append_safe(buf, &pos, bufsize, "Lookups: %lu direct, %lu hash (%.2f probes avg, p99 <%lu)\n",
+                s.lookups_direct, s.lookups_hash, s.lookups_hash ? (double)s.hash_probes / s.lookups_hash : 0.0,
+                stats_percentile(s.probe_len, 0.99));
+    append_safe(buf, &pos, bufsize, "Dijkstra: %lu runs, %lu nodes settled\n", s.dijkstra_runs, s.dijkstra_settled);
+    append_safe(buf, &pos, bufsize, "Persistence: %lu journal bytes in %lu commits, %lu snapshot bytes in %lu checkpoints\n",
+                s.journal_bytes, s.commits, s.snapshot_bytes, s.checkpoints);
+    append_safe(buf, &pos, bufsize, "Allocator: %lu allocs, %lu frees, %lu slabs\n", s.slab_allocs, s.slab_frees, s.slabs_created);
+#endif
+    buf[pos]='\0';
 }
 
-void backend_undo() {
-    if (top < 0) return;
-    struct customer last = undo_stack[top--];
-    int id = last.reservation_id;
-    backend_cancel(id);
+/* ------------- file persistence ------------- */
+/* The CSV files plus meta.txt form a snapshot; every mutation after it is
+   appended to journal.bin. A snapshot is only paired with the journal whose
+   header carries the same generation as meta.txt. */
+static int fsync_file(FILE *f) {
+    if (fflush(f) != 0) return -1;
+#ifdef _WIN32
+    return _commit(_fileno(f));
+#else
+    return fsync(fileno(f));
+#endif
 }
 
-/* ----------------- HASH ----------------- */
-static int hashFunction(int reservation_id) {
-    if (reservation_id < 0) reservation_id = -reservation_id;
-    return reservation_id % HASH_SIZE;
+/* rename() over an existing file is not allowed on Windows */
+static int replace_file(const char *tmp, const char *dst) {
+#ifdef _WIN32
+    remove(dst);
+#endif
+    return rename(tmp, dst);
 }
 
-static void init_hash_table() {
-    for (int i = 0; i < HASH_SIZE; i++) hashTable[i] = NULL;
+static uint32_t crc32_local(uint32_t crc, const void *data, size_t len) {
+    static uint32_t table[256];
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+    const unsigned char *p = data;
+    crc = ~crc;
+    while (len--) crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
 }
 
-static void insertRecord(struct customer *p) {
-    if (!p) return;
-    int idx = hashFunction(p->reservation_id);
-    struct HashNode *node = (struct HashNode*)malloc(sizeof(struct HashNode));
-    if (!node) return;
-    node->reservation_id = p->reservation_id;
-    node->custPtr = p;
-    node->next = hashTable[idx];
-    hashTable[idx] = node;
+static void to_disk_record(const struct customer *c, struct DiskRecord *r) {
+    memset(r, 0, sizeof(*r));
+    r->reservation_id = c->reservation_id;
+    r->age = c->age;
+    r->slot_number = c->slot_number;
+    r->route_from = c->route_from;
+    r->route_to = c->route_to;
+    r->cost = c->cost;
+    r->status = c->status;
+    r->group_id = c->group_id;
+    r->path_rank = (uint8_t)c->path_rank;
+    memcpy(r->name, c->name, sizeof(r->name));
+    memcpy(r->contact, c->contact, sizeof(r->contact));
 }
 
-static struct customer* searchRecord(int reservation_id) {
-    int idx = hashFunction(reservation_id);
-    struct HashNode *h = hashTable[idx];
-    while (h) {
-        if (h->reservation_id == reservation_id) return h->custPtr;
-        h = h->next;
+static int write_csv_local(const char *path, const struct CustomerList *l) {
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return -1;
+    struct customer *t = l->head;
+    while (t) {
+        /* include cost as last field */
+        fprintf(f, "%d,%s,%d,%s,%d,%d,%d,%d\n", t->reservation_id, t->name, t->age, t->contact, t->slot_number, t->route_from, t->route_to, t->cost);
+        t = t->next;
     }
-    return NULL;
+    int err = ferror(f);
+    if (fclose(f) != 0) err = 1;
+    if (err) { remove(tmp); return -1; }
+    return replace_file(tmp, path);
 }
 
-static void deleteRecord(int reservation_id) {
-    int idx = hashFunction(reservation_id);
-    struct HashNode *h = hashTable[idx];
-    struct HashNode *prev = NULL;
-    while (h && h->reservation_id != reservation_id) {
-        prev = h;
-        h = h->next;
-    }
-    if (!h) return;
-    if (!prev) hashTable[idx] = h->next;
-    else prev->next = h->next;
-    free(h);
+/* Serializes the current state into a complete snapshot.bin image. The copy is
+   what lets the writer thread save it while bookings keep changing the lists. */
+static unsigned char *build_snapshot_image(unsigned generation, size_t *out_len) {
+    size_t count = (size_t)confirmed_list.count + waitlist.count;
+    size_t len = sizeof(struct SnapshotHeader) + count * sizeof(struct DiskRecord) +
+                 sizeof(uint32_t) + (size_t)leg_caps.count * sizeof(struct LegCap);
+    unsigned char *img = malloc(len);
+    if (!img) return NULL;
+    struct SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, 8);
+    h.version = SNAPSHOT_VERSION;
+    h.record_size = sizeof(struct DiskRecord);
+    h.generation = generation;
+    h.next_reservation_id = atomic_load(&next_reservation_id);
+    h.total_slots = total_slots;
+    h.booked_slots = booked_slots;
+    h.confirmed_count = (uint32_t)confirmed_list.count;
+    h.waitlist_count = (uint32_t)waitlist.count;
+    memcpy(img, &h, sizeof(h));
+    struct DiskRecord *r = (struct DiskRecord *)(img + sizeof(h));
+    for (struct customer *t = confirmed_list.head; t; t = t->next) to_disk_record(t, r++);
+    for (struct customer *t = waitlist.head; t; t = t->next) to_disk_record(t, r++);
+    uint32_t caps = (uint32_t)leg_caps.count;
+    memcpy(r, &caps, sizeof(caps));
+    memcpy((unsigned char *)r + sizeof(caps), leg_caps.items, sizeof(struct LegCap) * caps);
+    *out_len = len;
+    return img;
 }
 
-/* ----------------- PASSENGER LIST ----------------- */
-static void insert_customer_local(int reservation_id, const char name[], int age, const char contact[], int slot_number, int cost) {
-    struct customer *newc = (struct customer*)malloc(sizeof(struct customer));
-    if (!newc) return;
-    newc->reservation_id = reservation_id;
-    strncpy(newc->name, name, sizeof(newc->name)-1); newc->name[sizeof(newc->name)-1]='\0';
-    newc->age = age;
-    strncpy(newc->contact, contact, sizeof(newc->contact)-1); newc->contact[sizeof(newc->contact)-1]='\0';
-    newc->slot_number = slot_number;
-    newc->route_from = -1;
-    newc->route_to = -1;
-    newc->cost = cost;
-    newc->next = NULL;
+/* Writes snapshot.bin through a temp file; the rename is the commit point */
+static int write_snapshot_image(const unsigned char *img, size_t len, int fsync_policy) {
+    FILE *f = fopen(SNAPSHOT_FILE ".tmp", "wb");
+    if (!f) return -1;
+    int err = fwrite(img, 1, len, f) != len;
+    if (!err && fsync_policy != BACKEND_FSYNC_NONE && fsync_file(f) != 0) err = 1;
+    if (fclose(f) != 0) err = 1;
+    if (err) { remove(SNAPSHOT_FILE ".tmp"); return -1; }
+    return replace_file(SNAPSHOT_FILE ".tmp", SNAPSHOT_FILE);
+}
 
-    if (confirmed_list == NULL) confirmed_list = newc;
-    else {
-        struct customer *t = confirmed_list;
-        while (t->next) t = t->next;
-        t->next = newc;
+/* Opens journal.bin, truncating it to a bare header if fresh.
+   Returns the header size, or -1. */
+static long journal_open(unsigned generation, int fresh) {
+    if (journal.f) fclose(journal.f);
+    journal.f = fopen(JOURNAL_FILE, fresh ? "wb" : "ab");
+    if (!journal.f) return -1;
+    uint32_t gen = generation;
+    if (fresh) {
+        fwrite(JOURNAL_MAGIC, 1, 8, journal.f);
+        fwrite(&gen, sizeof(gen), 1, journal.f);
+        fsync_file(journal.f);
     }
-    insertRecord(newc);
+    journal.commits_since_sync = 0;
+    return 8 + sizeof(gen);
 }
 
-static void delete_customer_local(int reservation_id) {
-    struct customer *temp = confirmed_list, *prev = NULL;
-    if (!temp) return;
-    if (temp->reservation_id == reservation_id) {
-        deleteRecord(temp->reservation_id);
-        confirmed_list = temp->next;
-        free(temp);
-        booked_slots--;
-        return;
+/* Appends committed records to the open journal and applies the fsync policy */
+static int journal_write_local(const unsigned char *data, size_t len, int fsync_policy) {
+    if (!journal.f) return -1;
+    if (fwrite(data, 1, len, journal.f) != len) {
+        clearerr(journal.f);
+        return -1;
     }
-    while (temp && temp->reservation_id != reservation_id) {
-        prev = temp;
-        temp = temp->next;
+    journal.commits_since_sync++;
+    if (fsync_policy == BACKEND_FSYNC_ALWAYS ||
+        (fsync_policy == BACKEND_FSYNC_BATCH && journal.commits_since_sync >= JOURNAL_FSYNC_BATCH)) {
+        journal.commits_since_sync = 0;
+        return fsync_file(journal.f);
     }
-    if (!temp) return;
-    deleteRecord(temp->reservation_id);
-    prev->next = temp->next;
-    free(temp);
-    booked_slots--;
+    return fflush(journal.f);
 }
 
-/* ----------------- WAITLIST ----------------- */
-static void enqueue_waitlist_local(int reservation_id, const char name[], int age, const char contact[], int route_from, int route_to, int cost) {
-    struct customer *newr = (struct customer*)malloc(sizeof(struct customer));
-    if (!newr) return;
-    newr->reservation_id = reservation_id;
-    strncpy(newr->name, name, sizeof(newr->name)-1); newr->name[sizeof(newr->name)-1]='\0';
-    newr->age = age;
-    strncpy(newr->contact, contact, sizeof(newr->contact)-1); newr->contact[sizeof(newr->contact)-1]='\0';
-    newr->slot_number = -1;
-    newr->route_from = route_from;
-    newr->route_to = route_to;
-    newr->cost = cost;
-    newr->next = NULL;
+static void journal_commit_locked();
 
-    if (!waitlist) waitlist = newr;
-    else {
-        struct customer *t = waitlist;
-        while (t->next) t = t->next;
-        t->next = newr;
+static void journal_append(uint32_t type, const void *payload, uint32_t len) {
+    if (len > JREC_MAX_LEN) return; /* replay would drop it as torn; callers split with journal_append_array */
+    pthread_mutex_lock(&journal_lock);
+    size_t need = journal.len + sizeof(struct JournalRecHeader) + len;
+    if (need > journal.cap) {
+        size_t cap = journal.cap ? journal.cap : 4096;
+        while (cap < need) cap *= 2;
+        unsigned char *buf = realloc(journal.buf, cap);
+        if (!buf) { pthread_mutex_unlock(&journal_lock); return; }
+        journal.buf = buf;
+        journal.cap = cap;
     }
+    struct JournalRecHeader h;
+    h.type = type;
+    h.len = len;
+    h.crc = crc32_local(crc32_local(0, &type, sizeof(type)), payload, len);
+    memcpy(journal.buf + journal.len, &h, sizeof(h));
+    memcpy(journal.buf + journal.len + sizeof(h), payload, len);
+    journal.len = need;
+    journal.clean = 0;
+    if (journal.len >= JOURNAL_BUF_MAX) journal_commit_locked();
+    pthread_mutex_unlock(&journal_lock);
 }
 
-static void dequeue_waitlist_local() {
-    if (!waitlist) return;
-    struct customer *t = waitlist;
-    waitlist = waitlist->next;
-    free(t);
+/* PUTS/DELS payloads split into records no longer than JREC_MAX_LEN */
+static void journal_append_array(uint32_t type, const void *items, size_t count, size_t item_size) {
+    size_t per = JREC_MAX_LEN / item_size;
+    const unsigned char *p = items;
+    while (count > 0) {
+        size_t k = count < per ? count : per;
+        journal_append(type, p, (uint32_t)(k * item_size));
+        p += k * item_size;
+        count -= k;
+    }
 }
 
-/* ----------------- GRAPH UTILITIES (Dijkstra) ----------------- */
-void add_edge_local(struct Graph *g, int u, int v, int w) {
-    struct Edge *e = malloc(sizeof(struct Edge));
-    if (!e) return;
-    e->to = v; e->weight = w; e->next = g->adj[u];
-    g->adj[u] = e;
-    struct Edge *e2 = malloc(sizeof(struct Edge));
-    if (!e2) return;
-    e2->to = u; e2->weight = w; e2->next = g->adj[v];
-    g->adj[v] = e2;
+static void journal_put(const struct customer *c) {
+    if (!c) return;
+    struct DiskRecord r;
+    to_disk_record(c, &r);
+    journal_append(JREC_PUT, &r, sizeof(r));
 }
 
-/* Dijkstra: returns 0 on success; out_distance set to distance (>=0).
-   If no path exists, out_distance is set to -1 and function returns -1.
-   If out_path and out_len provided, path (sequence of node indices) is written into out_path (up to out_path_len),
-   and *out_len is set to the path length.
-*/
-static int dijkstra_shortest_path(struct Graph *g, int src, int dest, int *out_distance, int out_path[], int *out_len, int out_path_len) {
-    if (!g) return -1;
-    if (src < 0 || src >= g->n || dest < 0 || dest >= g->n) return -1;
-    int n = g->n;
-    int *dist = malloc(sizeof(int) * n);
-    int *prev = malloc(sizeof(int) * n);
-    int *visited = malloc(sizeof(int) * n);
-    if (!dist || !prev || !visited) {
-        free(dist); free(prev); free(visited);
-        return -1;
-    }
-    for (int i = 0; i < n; i++) {
-        dist[i] = INT_MAX;
-        prev[i] = -1;
-        visited[i] = 0;
-    }
-    dist[src] = 0;
-
-    for (int count = 0; count < n; count++) {
-        int u = -1;
-        int best = INT_MAX;
-        for (int i = 0; i < n; i++) {
-            if (!visited[i] && dist[i] < best) {
-                best = dist[i];
-                u = i;
-            }
-        }
-        if (u == -1) break;
-        visited[u] = 1;
-        if (u == dest) break;
-        struct Edge *e = g->adj[u];
-        while (e) {
-            int v = e->to;
-            if (!visited[v] && dist[u] != INT_MAX && dist[u] + e->weight < dist[v]) {
-                dist[v] = dist[u] + e->weight;
-                prev[v] = u;
-            }
-            e = e->next;
-        }
-    }
+static void journal_del(int reservation_id) {
+    int32_t id = reservation_id;
+    journal_append(JREC_DEL, &id, sizeof(id));
+}
 
-    if (dist[dest] == INT_MAX) {
-        free(dist); free(prev); free(visited);
-        if (out_distance) *out_distance = -1;
-        if (out_len) *out_len = 0;
-        return -1;
+static void journal_meta() {
+    int32_t m[3] = { atomic_load(&next_reservation_id), total_slots, booked_slots };
+    pthread_mutex_lock(&journal_lock);
+    int same = journal.meta_valid && memcmp(journal.meta, m, sizeof(m)) == 0;
+    memcpy(journal.meta, m, sizeof(m));
+    journal.meta_valid = 1;
+    pthread_mutex_unlock(&journal_lock);
+    if (!same) journal_append(JREC_META, m, sizeof(m));
+}
+
+/* ------------- background writer ------------- */
+static int persist_run_job(struct PersistJob *job) {
+    switch (job->kind) {
+    case PJOB_JOURNAL:
+        return journal_write_local(job->data, job->len, job->fsync_policy);
+    case PJOB_SNAPSHOT:
+        /* on failure keep appending to the old journal: it still matches the old snapshot */
+        if (write_snapshot_image(job->data, job->len, job->fsync_policy) != 0) return -1;
+        return journal_open(job->generation, 1) < 0 ? -1 : 0;
+    case PJOB_SYNC:
+        return journal.f ? fsync_file(journal.f) : 0;
     }
+    return 0;
+}
 
-    if (out_distance) *out_distance = dist[dest];
+/* Takes the whole queue at a time; a run of journal batches queued while the
+   previous write was in flight is written back to back with a single fsync. */
+static void *persist_thread_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&persist.lock);
+    for (;;) {
+        while (!persist.head && !persist.stop) pthread_cond_wait(&persist.wake, &persist.lock);
+        if (!persist.head) break; /* stopping and drained */
+        struct PersistJob *job = persist.head;
+        persist.head = persist.tail = NULL;
+        persist.busy = 1;
+        pthread_mutex_unlock(&persist.lock);
 
-    if (out_path && out_len) {
-        int tmp[512];
-        int idx = 0;
-        int cur = dest;
-        while (cur != -1 && idx < 511) {
-            tmp[idx++] = cur;
-            cur = prev[cur];
-        }
-        /* reverse into out_path */
-        int plen = (idx < out_path_len) ? idx : out_path_len;
-        for (int i = 0; i < plen; i++) {
-            out_path[i] = tmp[idx - 1 - i];
+        int rc = 0;
+        while (job) {
+            struct PersistJob *next = job->next;
+            if (job->kind == PJOB_JOURNAL && next && next->kind == PJOB_JOURNAL) {
+                if (journal_write_local(job->data, job->len, BACKEND_FSYNC_NONE) != 0) rc = -1;
+            } else if (persist_run_job(job) != 0) {
+                rc = -1;
+            }
+            free(job->data);
+            free(job);
+            job = next;
         }
-        *out_len = plen;
+
+        pthread_mutex_lock(&persist.lock);
+        persist.busy = 0;
+        if (rc != 0) persist.failed = 1;
+        if (!persist.head) pthread_cond_broadcast(&persist.idle);
     }
+    pthread_mutex_unlock(&persist.lock);
+    return NULL;
+}
 
-    free(dist); free(prev); free(visited);
+/* Queues a job for the writer; takes ownership of data */
+static int persist_enqueue(int kind, unsigned char *data, size_t len, unsigned generation) {
+    struct PersistJob *job = malloc(sizeof(struct PersistJob));
+    if (!job) return -1;
+    job->kind = kind;
+    job->fsync_policy = journal.fsync_policy;
+    job->generation = generation;
+    job->data = data;
+    job->len = len;
+    job->next = NULL;
+    pthread_mutex_lock(&persist.lock);
+    if (persist.tail) persist.tail->next = job;
+    else persist.head = job;
+    persist.tail = job;
+    pthread_cond_signal(&persist.wake);
+    pthread_mutex_unlock(&persist.lock);
     return 0;
 }
 
-/* Helper: compute distance and cost if path exists. Returns distance or -1 if no path. */
-static int compute_route_distance_and_cost(int from, int to, int *out_cost) {
-    if (!route_graph) return -1;
-    if (from < 0 || from >= route_graph->n || to < 0 || to >= route_graph->n) return -1;
-    int dist = -1;
-    int res = dijkstra_shortest_path(route_graph, from, to, &dist, NULL, NULL, 0);
-    if (res != 0 || dist < 0) return -1;
-    if (out_cost) *out_cost = dist * PRICE_PER_UNIT;
-    return dist;
+/* Barrier: returns once everything committed so far is written and fsynced.
+   Returns -1 if any background write failed since the last flush. */
+int backend_flush() {
+    backend_commit();
+    if (!persist.running) {
+        pthread_mutex_lock(&journal_lock);
+        int rc = (journal.f && fsync_file(journal.f) != 0) ? -1 : 0;
+        pthread_mutex_unlock(&journal_lock);
+        return rc;
+    }
+    persist_enqueue(PJOB_SYNC, NULL, 0, 0);
+    pthread_mutex_lock(&persist.lock);
+    while (persist.head || persist.busy) pthread_cond_wait(&persist.idle, &persist.lock);
+    int failed = persist.failed;
+    persist.failed = 0;
+    pthread_mutex_unlock(&persist.lock);
+    return failed ? -1 : 0;
 }
 
-/*Piyush  book/cancel/modify/search wrappers for GUI */
-int backend_book(const char *name, int age, const char *contact, int route_from, int route_to) {
-    /* Validate route indices */
-    if (route_from < 0 || route_from >= CITY_COUNT || route_to < 0 || route_to >= CITY_COUNT) {
-        return -1; /* invalid indices */
-    }
-    /* Check shortest path exists and compute cost */
-    int cost = 0;
-    int dist = compute_route_distance_and_cost(route_from, route_to, &cost);
-    if (dist < 0) {
-        return -1; /* no route exists */
+/* persist.running only changes under journal_lock, so committers see a
+   consistent owner for journal.f. The writer drains its queue before exiting. */
+static void persist_stop() {
+    if (!persist.running) return;
+    backend_flush();
+    pthread_mutex_lock(&journal_lock);
+    if (persist.running) {
+        pthread_mutex_lock(&persist.lock);
+        persist.stop = 1;
+        pthread_cond_signal(&persist.wake);
+        pthread_mutex_unlock(&persist.lock);
+        pthread_join(persist.thread, NULL);
+        persist.running = 0;
+        persist.stop = 0;
     }
+    pthread_mutex_unlock(&journal_lock);
+}
 
-    int reservation_id = next_reservation_id++;
-    if (booked_slots < total_slots) {
-        insert_customer_local(reservation_id, name, age, contact, ++booked_slots, cost);
-        struct customer *node = searchRecord(reservation_id);
-        if (node) {
-            node->route_from = route_from;
-            node->route_to = route_to;
-            node->cost = cost;
-        }
-        struct customer temp;
-        temp.reservation_id = reservation_id;
-        strncpy(temp.name, name, sizeof(temp.name)-1); temp.name[sizeof(temp.name)-1]='\0';
-        temp.age = age;
-        strncpy(temp.contact, contact, sizeof(temp.contact)-1); temp.contact[sizeof(temp.contact)-1]='\0';
-        temp.slot_number = booked_slots;
-        temp.route_from = route_from;
-        temp.route_to = route_to;
-        temp.cost = cost;
-        push_undo_local(temp);
-    } else {
-        enqueue_waitlist_local(reservation_id, name, age, contact, route_from, route_to, cost);
+/* In async mode backend_commit/backend_checkpoint hand their data to a writer
+   thread and return immediately; use backend_flush() before exiting. */
+void backend_set_async_persistence(int enabled) {
+    if (!enabled) {
+        persist_stop();
+        return;
     }
-    return reservation_id;
+    pthread_mutex_lock(&journal_lock);
+    if (!persist.running) {
+        persist.stop = 0;
+        persist.failed = 0;
+        if (pthread_create(&persist.thread, NULL, persist_thread_main, NULL) == 0) persist.running = 1;
+    }
+    pthread_mutex_unlock(&journal_lock);
 }
 
-void backend_cancel(int reservation_id) {
-    delete_customer_local(reservation_id);
-    if (waitlist) {
-        struct customer *temp = waitlist;
-        insert_customer_local(temp->reservation_id, temp->name, temp->age, temp->contact, ++booked_slots, temp->cost);
-        struct customer *node = searchRecord(temp->reservation_id);
-        if (node) {
-            node->route_from = temp->route_from;
-            node->route_to = temp->route_to;
-            node->cost = temp->cost;
-        }
-        dequeue_waitlist_local();
+/* Group commit: everything queued since the last commit goes out in one write.
+   Caller holds journal_lock. */
+static void journal_commit_locked() {
+    if (journal.len == 0) return;
+    if (persist.running) {
+        size_t len = journal.len;
+        if (persist_enqueue(PJOB_JOURNAL, journal.buf, len, 0) != 0) return;
+        journal.buf = NULL; /* the writer owns it now */
+        journal.cap = 0;
+        journal.len = 0;
+        journal.size += (long)len;
+        STAT_ADD(journal_bytes, len);
+        STAT_ADD(commits, 1);
+        return;
     }
+    if (journal_write_local(journal.buf, journal.len, journal.fsync_policy) != 0) {
+        return; /* keep the records queued and retry on the next commit */
+    }
+    journal.size += (long)journal.len;
+    STAT_ADD(journal_bytes, journal.len);
+    STAT_ADD(commits, 1);
+    journal.len = 0;
 }
 
-void backend_modify(int reservation_id, const char *newname, int newage, const char *newcontact) {
-    struct customer *temp = searchRecord(reservation_id);
-    if (!temp) {
-        temp = waitlist;
-        while (temp && temp->reservation_id != reservation_id) temp = temp->next;
-    }
-    if (!temp) return;
-    if (newname && strlen(newname) > 0) strncpy(temp->name, newname, sizeof(temp->name)-1);
-    if (newage > 0) temp->age = newage;
-    if (newcontact && strlen(newcontact) > 0) strncpy(temp->contact, newcontact, sizeof(temp->contact)-1);
+void backend_commit() {
+    pthread_mutex_lock(&journal_lock);
+    journal_commit_locked();
+    pthread_mutex_unlock(&journal_lock);
 }
 
-int backend_search(int reservation_id) {
-    struct customer *found = searchRecord(reservation_id);
-    if (found) return 1; /* confirmed */
-    struct customer *t = waitlist;
-    while (t) {
-        if (t->reservation_id == reservation_id) return 2; /* waitlist */
-        t = t->next;
-    }
-    return 0;
+void backend_set_fsync_policy(int policy) {
+    if (policy < BACKEND_FSYNC_NONE || policy > BACKEND_FSYNC_ALWAYS) return;
+    pthread_mutex_lock(&journal_lock);
+    journal.fsync_policy = policy;
+    pthread_mutex_unlock(&journal_lock);
 }
 
-void backend_assign_route(int id, int from, int to) {
-    /* Attempt to compute cost and assign only if path exists */
-    if (!route_graph) return;
-    if (from < 0 || from >= route_graph->n || to < 0 || to >= route_graph->n) return;
-    int cost = 0;
-    int dist = compute_route_distance_and_cost(from, to, &cost);
-    if (dist < 0) {
-        /* invalid route -> do nothing */
+/* Writes a full snapshot under the next generation and starts an empty journal.
+   Every record is held still while the image is built, so no mutation can land
+   in the old journal after the copy was taken. Skipped if nothing was journaled
+   since the last checkpoint. */
+void backend_checkpoint() {
+    records_read_lock();
+    pthread_mutex_lock(&journal_lock);
+    if (journal.clean) {
+        pthread_mutex_unlock(&journal_lock);
+        records_read_unlock();
         return;
     }
-    struct customer *c = searchRecord(id);
-    if (c) {
-        c->route_from = from; c->route_to = to; c->cost = cost; return;
+    journal_commit_locked();
+    unsigned generation = journal.generation + 1;
+    size_t len = 0;
+    unsigned char *img = build_snapshot_image(generation, &len);
+    int rc = img ? 0 : -1;
+    if (img && persist.running) {
+        if (persist_enqueue(PJOB_SNAPSHOT, img, len, generation) != 0) { free(img); rc = -1; }
+    } else if (img) {
+        rc = write_snapshot_image(img, len, journal.fsync_policy);
+        free(img);
+        if (rc == 0) journal_open(generation, 1);
     }
-    struct customer *t = waitlist;
-    while (t) {
-        if (t->reservation_id == id) { t->route_from = from; t->route_to = to; t->cost = cost; return; }
-        t = t->next;
+    if (rc == 0) {
+        journal.generation = generation;
+        journal.size = 8 + sizeof(uint32_t);
+        journal.clean = 1;
+        STAT_ADD(snapshot_bytes, len);
+        STAT_ADD(checkpoints, 1);
     }
+    pthread_mutex_unlock(&journal_lock);
+    records_read_unlock();
 }
 
-/* Helper safe append */
-static void append_safe(char *buf, int *pos, int size, const char *fmt, ...) {
-    if (*pos >= size-1) return;
-    va_list ap;
-    va_start(ap, fmt);
-    int r = vsnprintf(buf + *pos, size - *pos, fmt, ap);
-    va_end(ap);
-    if (r > 0) *pos += r;
-    if (*pos > size-1) *pos = size-1;
+void backend_save_all() {
+    backend_commit();
+    pthread_mutex_lock(&journal_lock);
+    int full = journal.size >= JOURNAL_CHECKPOINT_BYTES;
+    pthread_mutex_unlock(&journal_lock);
+    if (full) backend_checkpoint();
 }
 
-void backend_get_confirmed_text(char *buf, int bufsize) {
-    int pos = 0;
-    if (!confirmed_list) {
-        append_safe(buf, &pos, bufsize, "No confirmed reservations.\n");
-        buf[pos]='\0';
-        return;
-    }
-    struct customer *t = confirmed_list;
-    while (t) {
-        append_safe(buf, &pos, bufsize, "ID:%d | %s | Age:%d | Contact:%s | Slot:%d", t->reservation_id, t->name, t->age, t->contact, t->slot_number);
-        if (t->route_from != -1 || t->route_to != -1) {
-            const char *from = (t->route_from >=0 && t->route_from < CITY_COUNT) ? CityName[t->route_from] : "N/A";
-            const char *to   = (t->route_to   >=0 && t->route_to   < CITY_COUNT) ? CityName[t->route_to]   : "N/A";
-            append_safe(buf, &pos, bufsize, " | Route:%s->%s | Cost:₹%d", from, to, t->cost);
+/* Writes confirmed.csv, waitlist.csv and meta.txt for tools that read the old
+   text format. Checkpoints first so the CSV files, snapshot.bin and the journal
+   all agree on one generation. */
+int backend_export_csv() {
+    backend_checkpoint();
+    if (backend_flush() != 0) return -1;
+    records_read_lock();
+    int rc = -1;
+    if (write_csv_local(CONFIRMED_FILE, &confirmed_list) == 0 && write_csv_local(WAITLIST_FILE, &waitlist) == 0) {
+        FILE *f = fopen(META_FILE, "w");
+        if (f) {
+            pthread_mutex_lock(&journal_lock);
+            fprintf(f, "%d\n%d\n%d\n%u\n", atomic_load(&next_reservation_id), total_slots, booked_slots, journal.generation);
+            pthread_mutex_unlock(&journal_lock);
+            rc = fclose(f) == 0 ? 0 : -1;
         }
-        append_safe(buf, &pos, bufsize, "\n");
-        t = t->next;
     }
-    buf[pos]='\0';
+    records_read_unlock();
+    return rc;
 }
 
-void backend_get_waitlist_text(char *buf, int bufsize) {
-    int pos = 0;
-    if (!waitlist) { append_safe(buf, &pos, bufsize, "Waitlist empty.\n"); buf[pos]='\0'; return; }
-    struct customer *t = waitlist;
-    while (t) {
-        append_safe(buf, &pos, bufsize, "ID:%d | %s | Age:%d | Contact:%s", t->reservation_id, t->name, t->age, t->contact);
-        if (t->route_from != -1 || t->route_to != -1) {
-            const char *from = (t->route_from >=0 && t->route_from < CITY_COUNT) ? CityName[t->route_from] : "N/A";
-            const char *to   = (t->route_to   >=0 && t->route_to   < CITY_COUNT) ? CityName[t->route_to]   : "N/A";
-            append_safe(buf, &pos, bufsize, " | Route:%s->%s | Cost:₹%d", from, to, t->cost);
+/* ------------- journal replay ------------- */
+static void unlink_record_local(struct customer *c) {
+    list_unlink(c->status == RES_WAITLISTED ? &waitlist : &confirmed_list, c);
+}
+
+static void copy_disk_record(struct customer *c, const struct DiskRecord *r) {
+    memcpy(c->name, r->name, sizeof(c->name));
+    c->name[sizeof(c->name)-1] = '\0';
+    memcpy(c->contact, r->contact, sizeof(c->contact));
+    c->contact[sizeof(c->contact)-1] = '\0';
+    c->age = r->age;
+    c->slot_number = r->slot_number;
+    c->route_from = r->route_from;
+    c->route_to = r->route_to;
+    c->cost = r->cost;
+    c->group_id = r->group_id;
+    c->path_rank = r->path_rank;
+}
+
+/* Creates a record straight from its disk form and appends it to its list */
+static struct customer *materialize_record_local(const struct DiskRecord *r) {
+    struct customer *c = slab_alloc(&customer_pool);
+    if (!c) return NULL;
+    c->reservation_id = r->reservation_id;
+    c->status = (r->status == RES_WAITLISTED) ? RES_WAITLISTED : RES_CONFIRMED;
+    copy_disk_record(c, r);
+    list_append(c->status == RES_WAITLISTED ? &waitlist : &confirmed_list, c);
+    insertRecord(c);
+    lookup_add(c);
+    route_index_add(c);
+    return c;
+}
+
+static void apply_put_local(const struct DiskRecord *r) {
+    struct customer *c = searchRecord(r->reservation_id);
+    if (!c) {
+        c = materialize_record_local(r);
+        if (!c) return;
+    } else {
+        route_index_remove(c);
+        if (c->status != r->status) {
+            unlink_record_local(c);
+            c->status = r->status;
+            list_append(c->status == RES_WAITLISTED ? &waitlist : &confirmed_list, c);
         }
-        append_safe(buf, &pos, bufsize, "\n");
-        t = t->next;
+        lookup_remove(c);
+        copy_disk_record(c, r);
+        lookup_add(c);
+        route_index_add(c);
     }
-    buf[pos]='\0';
+    /* a torn tail can lose the META record that followed this one */
+    if (c->reservation_id >= atomic_load(&next_reservation_id)) atomic_store(&next_reservation_id, c->reservation_id + 1);
 }
 
-void backend_get_slotmap_text(char *buf, int bufsize) {
-    int pos = 0;
-    for (int i = 1; i <= total_slots; i++) {
-        int found = 0;
-        struct customer *t = confirmed_list;
-        while (t) {
-            if (t->slot_number == i) {
-                append_safe(buf, &pos, bufsize, "Slot %d - %s (ID:%d)\n", i, t->name, t->reservation_id);
-                found = 1; break;
+static void apply_del_local(int reservation_id) {
+    struct customer *c = searchRecord(reservation_id);
+    if (!c) return;
+    unlink_record_local(c);
+    deleteRecord(reservation_id);
+    lookup_remove(c);
+    route_index_remove(c);
+    epoch_retire(c, RETIRE_RECORD);
+}
+
+/* Replays journal.bin on top of the loaded snapshot and reopens it for
+   appending. A torn or corrupt tail ends the replay; the recovered state is
+   then checkpointed so the damaged bytes are never appended to. */
+static void journal_recover(unsigned generation) {
+    FILE *f = fopen(JOURNAL_FILE, "rb");
+    char magic[8];
+    uint32_t gen;
+    if (!f || fread(magic, 1, 8, f) != 8 || memcmp(magic, JOURNAL_MAGIC, 8) != 0 ||
+        fread(&gen, sizeof(gen), 1, f) != 1 || gen != generation) {
+        /* missing, or already folded into the snapshot */
+        if (f) fclose(f);
+        long header = journal_open(generation, 1);
+        journal.generation = generation;
+        journal.size = header > 0 ? header : 0;
+        return;
+    }
+    long good = 8 + sizeof(gen);
+    int torn = 0;
+    /* grown for batch records; single records fit the initial size */
+    size_t payload_cap = sizeof(struct DiskRecord);
+    unsigned char *payload = malloc(payload_cap);
+    struct JournalRecHeader h;
+    while (payload && fread(&h, sizeof(h), 1, f) == 1) {
+        if (h.len > payload_cap && h.len <= JREC_MAX_LEN) {
+            unsigned char *p = realloc(payload, h.len);
+            if (p) { payload = p; payload_cap = h.len; }
+        }
+        if (h.len > payload_cap || fread(payload, 1, h.len, f) != h.len ||
+            crc32_local(crc32_local(0, &h.type, sizeof(h.type)), payload, h.len) != h.crc) {
+            torn = 1;
+            break;
+        }
+        if (h.type == JREC_PUT && (h.len == sizeof(struct DiskRecord) || h.len == DISK_RECORD_V1_SIZE)) {
+            struct DiskRecord r;
+            memset(&r, 0, sizeof(r));
+            memcpy(&r, payload, h.len);
+            apply_put_local(&r);
+        } else if (h.type == JREC_DEL && h.len == sizeof(int32_t)) {
+            int32_t id;
+            memcpy(&id, payload, sizeof(id));
+            apply_del_local(id);
+        } else if (h.type == JREC_META && h.len == 3 * sizeof(int32_t)) {
+            int32_t m[3];
+            memcpy(m, payload, sizeof(m));
+            atomic_store(&next_reservation_id, m[0]); total_slots = m[1]; booked_slots = m[2];
+        } else if (h.type == JREC_PUTS && h.len % sizeof(struct DiskRecord) == 0) {
+            struct DiskRecord r;
+            for (uint32_t off = 0; off < h.len; off += sizeof(r)) {
+                memcpy(&r, payload + off, sizeof(r));
+                apply_put_local(&r);
+            }
+        } else if (h.type == JREC_LEGCAP && h.len == sizeof(struct LegCap)) {
+            struct LegCap lc;
+            memcpy(&lc, payload, sizeof(lc));
+            if (lc.from < 0) leg_caps_clear();
+            else leg_caps_save(lc.from, lc.to, lc.seats);
+        } else if (h.type == JREC_DELS && h.len % sizeof(int32_t) == 0) {
+            int32_t id;
+            for (uint32_t off = 0; off < h.len; off += sizeof(id)) {
+                memcpy(&id, payload + off, sizeof(id));
+                apply_del_local(id);
             }
-            t = t->next;
         }
-        if (!found) append_safe(buf, &pos, bufsize, "Slot %d - Available\n", i);
+        good += (long)(sizeof(h) + h.len);
     }
-    buf[pos]='\0';
+    if (!payload || !feof(f)) torn = 1;
+    free(payload);
+    fclose(f);
+
+    journal.generation = generation;
+    if (torn) {
+        backend_checkpoint();
+        return;
+    }
+    journal_open(generation, 0);
+    journal.size = good;
 }
 
-void backend_get_availability_text(char *buf, int bufsize) {
-    int pos = 0;
-    append_safe(buf, &pos, bufsize, "Total: %d\nBooked: %d\nAvailable: %d\n", total_slots, booked_slots, total_slots - booked_slots);
-    buf[pos]='\0';
+/* ------------- load & init ------------- */
+/* Maps the whole file read-only; falls back to reading it into memory */
+static void *map_file_local(const char *path, size_t *size) {
+#ifdef _WIN32
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void *data = len > 0 ? malloc(len) : NULL;
+    if (data && fread(data, 1, len, f) != (size_t)len) { free(data); data = NULL; }
+    fclose(f);
+    *size = data ? (size_t)len : 0;
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void *data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) data = NULL;
+    }
+    close(fd);
+    *size = data ? (size_t)st.st_size : 0;
+    return data;
+#endif
 }
 
-/* ------------- file persistence ------------- */
-void backend_save_all() {
-    /* confirmed */
-    FILE *f = fopen(CONFIRMED_FILE, "w");
+static void unmap_file_local(void *data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    free(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+/* Loads snapshot.bin: the records are fixed width, so this is one linear pass
+   over the mapped file with no parsing. Returns -1 if there is no usable snapshot. */
+static int load_snapshot_local(unsigned *generation) {
+    size_t size = 0;
+    unsigned char *data = map_file_local(SNAPSHOT_FILE, &size);
+    if (!data) return -1;
+#ifndef _WIN32
+    posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+#endif
+    struct SnapshotHeader h;
+    uint32_t caps = 0;
+    int ok = size >= sizeof(h);
+    if (ok) {
+        memcpy(&h, data, sizeof(h));
+        size_t body = sizeof(h) + ((size_t)h.confirmed_count + h.waitlist_count) * h.record_size;
+        ok = memcmp(h.magic, SNAPSHOT_MAGIC, 8) == 0 &&
+             (((h.version == SNAPSHOT_VERSION || h.version == 2) && h.record_size == sizeof(struct DiskRecord)) ||
+              (h.version == 1 && h.record_size == DISK_RECORD_V1_SIZE));
+        /* versions before 3 end with the records; leg capacities were not saved */
+        if (ok && h.version >= 3) {
+            ok = size >= body + sizeof(caps);
+            if (ok) memcpy(&caps, data + body, sizeof(caps));
+            ok = ok && size == body + sizeof(caps) + (size_t)caps * sizeof(struct LegCap);
+        } else {
+            ok = ok && size == body;
+        }
+    }
+    if (!ok) {
+        unmap_file_local(data, size);
+        return -1;
+    }
+    const unsigned char *recs = data + sizeof(h);
+    size_t total = (size_t)h.confirmed_count + h.waitlist_count;
+    if (h.record_size == sizeof(struct DiskRecord)) {
+        for (size_t i = 0; i < total; i++) materialize_record_local((const struct DiskRecord *)recs + i);
+    } else {
+        /* version 1: shorter records without group_id */
+        struct DiskRecord r;
+        memset(&r, 0, sizeof(r));
+        for (size_t i = 0; i < total; i++) {
+            memcpy(&r, recs + i * h.record_size, h.record_size);
+            materialize_record_local(&r);
+        }
+    }
+    const unsigned char *lc = recs + total * h.record_size + sizeof(caps);
+    for (uint32_t i = 0; i < caps; i++) {
+        struct LegCap c;
+        memcpy(&c, lc + i * sizeof(c), sizeof(c));
+        leg_caps_save(c.from, c.to, c.seats);
+    }
+    atomic_store(&next_reservation_id, h.next_reservation_id);
+    total_slots = h.total_slots;
+    booked_slots = h.booked_slots;
+    *generation = h.generation;
+    unmap_file_local(data, size);
+    return 0;
+}
+
+/* CSV import path (files written by older versions or backend_export_csv).
+   Returns the snapshot generation from meta.txt. */
+static unsigned load_csv_local() {
+    /* load meta (4th line, the snapshot generation, is absent in older files) */
+    unsigned generation = 0;
+    FILE *f = fopen(META_FILE, "r");
     if (f) {
-        struct customer *t = confirmed_list;
-        while (t) {
-            /* include cost as last field */
-            fprintf(f, "%d,%s,%d,%s,%d,%d,%d,%d\n", t->reservation_id, t->name, t->age, t->contact, t->slot_number, t->route_from, t->route_to, t->cost);
-            t = t->next;
+        int next_id = 1000;
+        if (fscanf(f, "%d\n%d\n%d\n", &next_id, &total_slots, &booked_slots) != 3) {
+            next_id = 1000; total_slots = 5; booked_slots = 0;
+        } else if (fscanf(f, "%u", &generation) != 1) {
+            generation = 0;
         }
+        atomic_store(&next_reservation_id, next_id);
         fclose(f);
     }
-    /* waitlist */
-    f = fopen(WAITLIST_FILE, "w");
+
+    /* confirmed */
+    f = fopen(CONFIRMED_FILE, "r");
     if (f) {
-        struct customer *t = waitlist;
-        while (t) {
-            fprintf(f, "%d,%s,%d,%s,%d,%d,%d,%d\n", t->reservation_id, t->name, t->age, t->contact, t->slot_number, t->route_from, t->route_to, t->cost);
-            t = t->next;
+        int id, age, slot, rf, rt, cost;
+        char name[50], contact[15];
+        while (fscanf(f, "%d,%49[^,],%d,%14[^,],%d,%d,%d,%d\n", &id, name, &age, contact, &slot, &rf, &rt, &cost) == 8) {
+            insertRecord(insert_customer_local(id, name, age, contact, slot, rf, rt, cost));
         }
         fclose(f);
     }
-    /* meta */
-    f = fopen(META_FILE, "w");
+
+    /* waitlist */
+    f = fopen(WAITLIST_FILE, "r");
     if (f) {
-        fprintf(f, "%d\n%d\n%d\n", next_reservation_id, total_slots, booked_slots);
+        int id, age, slot, rf, rt, cost;
+        char name[50], contact[15];
+        while (fscanf(f, "%d,%49[^,],%d,%14[^,],%d,%d,%d,%d\n", &id, name, &age, contact, &slot, &rf, &rt, &cost) == 8) {
+            insertRecord(enqueue_waitlist_local(id, name, age, contact, rf, rt, cost, 0));
+        }
         fclose(f);
     }
+    return generation;
+}
+
+/* Forgets every record and the route graph, returning their memory in one go.
+   Like backend_init, must not overlap any other backend call. */
+void backend_shutdown() {
+    backend_commit();
+    persist_stop();
+    if (journal.f) {
+        fsync_file(journal.f);
+        fclose(journal.f);
+        journal.f = NULL;
+    }
+    journal.len = 0;
+    journal.size = 0;
+    journal.clean = 0;
+    journal.meta_valid = 0;
+    epoch_reset();
+    init_res_index();
+    lookup_reset();
+    wait_index_reset();
+    route_index_reset();
+    confirmed_list.head = confirmed_list.tail = NULL;
+    confirmed_list.count = 0;
+    waitlist.head = waitlist.tail = NULL;
+    waitlist.count = 0;
+    undo_reset();
+    slot_free_all();
+    pthread_rwlock_wrlock(&legs_lock);
+    legs_reset();
+    pthread_rwlock_unlock(&legs_lock);
+    leg_caps_clear();
+    waitlist_blocked = 0;
+    total_slots = 5;
+    booked_slots = 0;
+    atomic_store(&next_reservation_id, 1000);
+    slab_init(&customer_pool, sizeof(struct customer));
+    if (route_graph) {
+        free(route_graph->adj);
+        free(route_graph);
+        route_graph = NULL;
+        route_graph_version++;
+    }
+    slab_init(&edge_pool, sizeof(struct Edge));
+    slots_publish();
 }
 
-/* ------------- load & init ------------- */
 void backend_init() {
-    init_hash_table();
+    backend_shutdown();
     /* routes demo graph (CITY_COUNT nodes) */
     route_graph = malloc(sizeof(struct Graph));
     if (!route_graph) return;
     route_graph->n = CITY_COUNT;
+    route_graph->legs = 0;
     route_graph->adj = malloc(sizeof(struct Edge *) * route_graph->n);
     for (int i=0;i<route_graph->n;i++) route_graph->adj[i]=NULL;
 
@@ -526,83 +4516,267 @@ void backend_init() {
     add_edge_local(route_graph,2,4,6);  /* Chennai - Goa (6) */
     add_edge_local(route_graph,4,5,2);  /* Goa - Bangalore (2) */
     add_edge_local(route_graph,3,5,10); /* Kolkata - Bangalore (10) */
+    route_cache_warm();
 
-    /* load meta */
-    FILE *f = fopen(META_FILE, "r");
-    if (f) {
-        if (fscanf(f, "%d\n%d\n%d\n", &next_reservation_id, &total_slots, &booked_slots) != 3) {
-            next_reservation_id = 1000; total_slots = 5; booked_slots = 0;
-        }
-        fclose(f);
+    /* bulk load from large arena slabs: binary snapshot, else the CSV files */
+    slab_arena_begin(&customer_pool);
+    unsigned generation = 0;
+    if (load_snapshot_local(&generation) != 0) generation = load_csv_local();
+
+    /* replay mutations made after the snapshot */
+    journal_recover(generation);
+    slab_arena_end(&customer_pool);
+    slot_rebuild_local();
+    if (promote_waitlist_local() > 0) journal_meta();
+    slots_publish();
+}
+
+/* Sets the slot count unless an occupied slot would fall outside 1..n. Caller
+   holds state_lock and promotes the waitlist afterwards. 0 if refused. */
+static int change_slots_locked(int n) {
+    if (n < 1 || n < booked_slots || n < slot_highest_used() || slot_reserve(n) != 0) return 0;
+    total_slots = n;
+    return 1;
+}
+
+void backend_change_slots(int n) {
+    // Do not drop an occupied slot
+    if (n < 1) return;
+    pthread_mutex_lock(&state_lock);
+    int old_n = total_slots;
+    if (change_slots_locked(n)) {
+        if (n != old_n) undo_record_slots(old_n, n);
+        promote_waitlist_local();
+        journal_meta();
+        slots_publish();
     }
+    pthread_mutex_unlock(&state_lock);
+}
 
-    /* confirmed */
-    f = fopen(CONFIRMED_FILE, "r");
-    if (f) {
-        int id, age, slot, rf, rt, cost;
-        char name[50], contact[15];
-        while (fscanf(f, "%d,%49[^,],%d,%14[^,],%d,%d,%d,%d\n", &id, name, &age, contact, &slot, &rf, &rt, &cost) == 8) {
-            insert_customer_local(id, name, age, contact, slot, cost);
-            struct customer *c = searchRecord(id);
-            if (c) { c->route_from = rf; c->route_to = rt; c->cost = cost; }
+/* ----------------- UNDO REPLAY ----------------- */
+/* Applies entry e: its inverse for an undo, the change itself for a redo. A step
+   whose record is gone, or whose route or slot count no longer fits, changes
+   nothing. Caller holds every shard exclusively and state_lock. */
+static void undo_apply(const struct UndoEntry *e, int redo) {
+    const unsigned char *p = e->b + sizeof(uint16_t);
+    int type = *p++;
+    if (type == UNDO_BOOK || type == UNDO_CANCEL) {
+        struct customer c;
+        undo_get_record(&p, &c);
+        /* undoing a booking cancels it, undoing a cancellation books it again */
+        if ((type == UNDO_BOOK) != redo) {
+            struct customer *gone = unindex_record(c.reservation_id);
+            if (gone) cancel_record_locked(gone, NULL);
+        } else {
+            restore_record_locked(&c);
         }
-        fclose(f);
+    } else if (type == UNDO_MODIFY) {
+        struct customer v[2]; /* old, new */
+        int id = undo_get_int(&p);
+        v[0].age = undo_get_int(&p);
+        v[1].age = undo_get_int(&p);
+        int changed = *p++;
+        if (changed & 1) { undo_get_str(&p, v[0].name); undo_get_str(&p, v[1].name); }
+        if (changed & 2) { undo_get_str(&p, v[0].contact); undo_get_str(&p, v[1].contact); }
+        modify_record_locked(id, (changed & 1) ? v[redo].name : NULL, v[redo].age,
+                             (changed & 2) ? v[redo].contact : NULL, NULL);
+    } else if (type == UNDO_ROUTE) {
+        int id = undo_get_int(&p), v[2][3]; /* old, new: from, to, cost */
+        for (int i = 0; i < 2; i++) {
+            for (int j = 0; j < 3; j++) v[i][j] = undo_get_int(&p);
+        }
+        assign_route_locked(id, v[redo][0], v[redo][1], v[redo][2], NULL);
+    } else if (type == UNDO_SLOTS) {
+        int n[2];
+        n[0] = undo_get_int(&p);
+        n[1] = undo_get_int(&p);
+        change_slots_locked(n[redo]);
+    } else if (type == UNDO_LEGCAP) {
+        int from = undo_get_int(&p), to = undo_get_int(&p), seats[2], old;
+        seats[0] = undo_get_int(&p);
+        seats[1] = undo_get_int(&p);
+        leg_capacity_locked(from, to, seats[redo], &old);
     }
+    /* a cancellation, a larger slot count or more seats on a leg can let
+       waitlisted bookings through */
+    promote_waitlist_local();
+    journal_meta();
+    slots_publish();
+}
 
-    /* waitlist */
-    f = fopen(WAITLIST_FILE, "r");
-    if (f) {
-        int id, age, slot, rf, rt, cost;
-        char name[50], contact[15];
-        while (fscanf(f, "%d,%49[^,],%d,%14[^,],%d,%d,%d,%d\n", &id, name, &age, contact, &slot, &rf, &rt, &cost) == 8) {
-            enqueue_waitlist_local(id, name, age, contact, rf, rt, cost);
-        }
-        fclose(f);
+int backend_undo() {
+    struct UndoEntry e;
+    shards_lock(SHARDS_ALL);
+    pthread_mutex_lock(&state_lock);
+    if (undo.cursor == undo.tail) {
+        pthread_mutex_unlock(&state_lock);
+        shards_unlock(SHARDS_ALL);
+        return 0;
     }
+    e.len = undo_size_at(undo.cursor - sizeof(uint16_t));
+    undo.cursor -= e.len;
+    undo_copy_out(undo.cursor, e.b, e.len);
+    undo_apply(&e, 0);
+    pthread_mutex_unlock(&state_lock);
+    shards_unlock(SHARDS_ALL);
+    return 1;
 }
 
-void backend_change_slots(int n) {
-    // Do not reduce below current bookings
-    if (n < 1) return;
-    if (n < booked_slots) return;
+int backend_redo() {
+    struct UndoEntry e;
+    shards_lock(SHARDS_ALL);
+    pthread_mutex_lock(&state_lock);
+    if (undo.cursor == undo.end) {
+        pthread_mutex_unlock(&state_lock);
+        shards_unlock(SHARDS_ALL);
+        return 0;
+    }
+    e.len = undo_size_at(undo.cursor);
+    undo_copy_out(undo.cursor, e.b, e.len);
+    undo.cursor += e.len;
+    undo_apply(&e, 1);
+    pthread_mutex_unlock(&state_lock);
+    shards_unlock(SHARDS_ALL);
+    return 1;
+}
 
-    total_slots = n;
+/* Replaces the demo route graph with n cities and m undirected edges
+   (from[i] <-> to[i] with weight[i]). Returns 0 on success, -1 on bad input. */
+int backend_load_routes(int n, const int *from, const int *to, const int *weight, int m) {
+    if (n < 1 || m < 0 || (m > 0 && (!from || !to || !weight))) return -1;
+    for (int i = 0; i < m; i++) {
+        if (from[i] < 0 || from[i] >= n || to[i] < 0 || to[i] >= n || weight[i] < 0) return -1;
+    }
+    struct Graph *g = malloc(sizeof(struct Graph));
+    if (!g) return -1;
+    g->n = n;
+    g->legs = 0;
+    g->adj = malloc(sizeof(struct Edge *) * n);
+    if (!g->adj) { free(g); return -1; }
+    for (int i = 0; i < n; i++) g->adj[i] = NULL;
+
+    /* state_lock so no leg counters get rebuilt with the old capacities */
+    pthread_mutex_lock(&state_lock);
+    pthread_rwlock_wrlock(&route_lock);
+    for (int i = 0; i < m; i++) add_edge_local(g, from[i], to[i], weight[i]);
+    free_graph_local(route_graph);
+    route_graph = g;
+    route_graph_version++;
+    route_cache_warm();
+    pthread_rwlock_unlock(&route_lock);
+    /* leg ids belong to the old graph: every leg starts unlimited */
+    if (leg_caps.count > 0) {
+        struct LegCap clear = { -1, -1, BACKEND_LEG_UNLIMITED };
+        leg_caps_clear();
+        journal_append(JREC_LEGCAP, &clear, sizeof(clear));
+    }
+    /* rebuild the counters now so path queries show seat status right away */
+    route_read_lock();
+    legs_sync_locked();
+    pthread_rwlock_unlock(&route_lock);
+    pthread_mutex_unlock(&state_lock);
+    return 0;
+}
+
+int backend_city_count() {
+    route_read_lock();
+    int n = route_graph ? route_graph->n : 0;
+    pthread_rwlock_unlock(&route_lock);
+    return n;
+}
+
+/* One Dijkstra run per call, so bench.c can time the search itself */
+int backend_route_distance(int from, int to) {
+    int dist = -1;
+    route_read_lock();
+    dijkstra_shortest_path(route_graph, from, to, &dist, NULL, NULL, 0);
+    pthread_rwlock_unlock(&route_lock);
+    return dist;
+}
+
+/* Cities past the demo names are numbered, as in backend_get_legs_text */
+int backend_city_name(int city, char *buf, int bufsize) {
+    if (!buf || bufsize <= 0) return -1;
+    if (city < 0 || city >= backend_city_count()) {
+        snprintf(buf, bufsize, "N/A");
+        return -1;
+    }
+    char tmp[16];
+    snprintf(buf, bufsize, "%s", city_name_local(city, tmp, sizeof(tmp)));
+    return 0;
 }
 
 /* ----------------- Shortest path text API ----------------- */
-/* Writes human-readable path, distance and cost into buf.
+/* Writes human-readable path, distance and cost into buf, followed by the
+   alternative routes a booking falls back to when a leg is full.
    Returns 0 on success, -1 on failure.
 */
 int backend_get_shortest_path_text(int from, int to, char *buf, int bufsize) {
     if (!buf || bufsize <= 0) return -1;
     buf[0] = '\0';
+    route_read_lock();
     if (!route_graph) {
+        pthread_rwlock_unlock(&route_lock);
         snprintf(buf, bufsize, "Route graph not initialized.\n");
         return -1;
     }
     if (from < 0 || from >= route_graph->n || to < 0 || to >= route_graph->n) {
         snprintf(buf, bufsize, "Invalid city indices. Valid: 0..%d\n", route_graph->n - 1);
+        pthread_rwlock_unlock(&route_lock);
         return -1;
     }
     int dist = -1;
     int path_nodes[512];
     int path_len = 0;
     int res = dijkstra_shortest_path(route_graph, from, to, &dist, path_nodes, &path_len, 512);
+    char a[16], b[16];
     if (res != 0 || dist < 0 || path_len == 0) {
+        pthread_rwlock_unlock(&route_lock);
         snprintf(buf, bufsize, "No route exists between %s and %s.\n",
-                 (from>=0 && from < CITY_COUNT) ? CityName[from] : "N/A",
-                 (to>=0 && to < CITY_COUNT) ? CityName[to] : "N/A");
+                 city_name_local(from, a, sizeof(a)), city_name_local(to, b, sizeof(b)));
         return -1;
     }
     int cost = dist * PRICE_PER_UNIT;
     int pos = 0;
     for (int i = 0; i < path_len; ++i) {
-        const char *name = (path_nodes[i] >=0 && path_nodes[i] < CITY_COUNT) ? CityName[path_nodes[i]] : "N/A";
+        const char *name = city_name_local(path_nodes[i], a, sizeof(a));
         if (i == 0) pos += snprintf(buf+pos, bufsize - pos, "%s", name);
         else pos += snprintf(buf+pos, bufsize - pos, " -> %s", name);
         if (pos >= bufsize-1) break;
     }
     pos += snprintf(buf+pos, bufsize - pos, "\nDistance: %d\nCost: ₹%d\n", dist, cost);
     if (pos >= bufsize) buf[bufsize-1] = '\0';
+    /* candidates in the order backend_book tries them; a miss is built outside
+       legs_lock and filed while the counters describe this graph (they cannot
+       go stale under route_lock), else kept private. Seat status only then. */
+    pthread_rwlock_rdlock(&legs_lock);
+    const struct RouteChoices *rc = legs.version == route_graph_version ? route_choices_find(from, to) : NULL;
+    struct RouteChoices *own = NULL;
+    if (!rc) {
+        pthread_rwlock_unlock(&legs_lock);
+        own = route_choices_build(from, to);
+        pthread_rwlock_wrlock(&legs_lock);
+        if (own && legs.version == route_graph_version) {
+            rc = route_choices_add(own);
+            own = NULL;
+        } else {
+            rc = own;
+        }
+    }
+    int current = legs.version == route_graph_version;
+    for (int r = 0; rc && rc->count > 1 && r < rc->count; r++) {
+        const struct LegPath *p = rc->path[r];
+        append_safe(buf, &pos, bufsize, "Option %d: ", r + 1);
+        for (int i = 0; i <= p->count; i++) {
+            int v = p->nodes[i];
+            append_safe(buf, &pos, bufsize, "%s%s", i ? " -> " : "", city_name_local(v, a, sizeof(a)));
+        }
+        append_safe(buf, &pos, bufsize, " (distance %d, ₹%d", p->dist, p->dist * PRICE_PER_UNIT);
+        if (current) append_safe(buf, &pos, bufsize, ", %s", legs_fit(p, 1) ? "seats free" : "full");
+        append_safe(buf, &pos, bufsize, ")\n");
+    }
+    pthread_rwlock_unlock(&legs_lock);
+    route_choices_free(own);
+    pthread_rwlock_unlock(&route_lock);
     return 0;
 }
@@ -4,6 +4,9 @@
 #ifndef BACKEND_H //guards 
 #define BACKEND_H //guards(so that it cannot be defined more than one time)
 
+//Thread safety: every backend_* call may be made from several threads at once,
+//except backend_init and backend_shutdown, which must not overlap any other call.
+//backend_search and backend_get_availability_text never wait for a writer.
 void backend_init();//loads data
 //Basic functions for the backend of the project
 int backend_book(const char *name, int age, const char *contact,int route_from, int route_to);
@@ -11,26 +14,164 @@ int backend_book(const char *name, int age, const char *contact,int route_from,
 
 void backend_cancel(int reservation_id);
 
+//bulk entry points: routes are priced once per distinct pair and the batch is journaled as one record.
+//results[i] is the reservation id (-1 if the route or input was invalid) / 1 if cancelled, 0 if unknown.
+//Both return the number of items that succeeded; cancelled slots are refilled in one waitlist pass.
+struct backend_booking {
+    const char *name;
+    int age;
+    const char *contact;
+    int route_from;
+    int route_to;
+};
+int backend_book_batch(const struct backend_booking *reqs, int n, int results[]);
+int backend_cancel_batch(const int ids[], int n, int results[]);
+
+//books k passengers sharing a contact into k adjacent slots, or queues all of them together;
+//ids receives the k reservation ids. Returns 1 (confirmed), 2 (waitlisted) or -1 (bad input/route,
+//or k larger than the slot count).
+//Waitlisted groups are promoted as a whole, in FIFO order with single bookings.
+int backend_book_group(int k, const char *const names[], const int ages[], const char *contact, int route_from, int route_to, int ids[]);
+
 void backend_modify(int reservation_id,const char *newname, int newage, const char *newcontact);
 
 
 int backend_search(int reservation_id);
 
+//lookups by passenger details, over confirmed and waitlisted records: fill ids with at most max
+//matching reservation ids and return how many were written (-1 if out of memory).
+//Contacts must match exactly; name prefixes ignore ASCII case and come back in name order.
+//The indexes behind them are built by the first call and kept current from then on.
+int backend_find_by_contact(const char *contact, int ids[], int max);
+int backend_find_by_name_prefix(const char *prefix, int ids[], int max);
+
+//per booked city pair (from -> to, direction as booked), kept up to date as records change,
+//so both calls cost the same at any size. Unbooked pairs read as all zero / no ids.
+struct backend_route_stats {
+    int confirmed;
+    int waitlisted;
+    long long revenue; //sum of cost over the confirmed bookings
+};
+int backend_get_route_stats(int from, int to, struct backend_route_stats *out);//-1 if out is NULL
+int backend_find_by_route(int from, int to, int ids[], int max);//ids written, at most max, no particular order
+
 void backend_assign_route(int reservation_id, int from, int to);
 
-void backend_undo();
+//undo/redo step through a bounded history of bookings, cancellations, modifications, route
+//assignments and slot count changes; the oldest steps drop out once it is full and a new change
+//drops the steps that could be redone. Both return 1 if a step was applied, 0 if there was none.
+int backend_undo();
+int backend_redo();
 
 
-void backend_change_slots(int n);
+void backend_change_slots(int n);//ignored if an occupied slot would fall outside 1..n
+int backend_get_slot_owner(int slot);//reservation id in that slot, 0 if free
 
 void backend_get_confirmed_text(char *buf, int bufsize);
 void backend_get_waitlist_text(char *buf, int bufsize);
 void backend_get_slotmap_text(char *buf, int bufsize);
+
+//paged listings: a cursor walks the confirmed list, the waitlist or the slot map a chunk at a time,
+//locking only for the duration of each call. Rows are never returned twice; records removed
+//between calls are skipped and records added meanwhile show up at the end of their list.
+#define BACKEND_LIST_CONFIRMED 1
+#define BACKEND_LIST_WAITLIST 2
+#define BACKEND_LIST_SLOTS 3 //one row per slot 1..total, reservation_id 0 if free
+struct backend_record {
+    int reservation_id;
+    char name[50];
+    int age;
+    char contact[15];
+    int slot_number; //-1 while waitlisted
+    int route_from;
+    int route_to;
+    int cost;
+    int group_id;
+    int status; //1 confirmed, 2 waitlisted, 0 for a free slot
+};
+struct backend_cursor { //set up with backend_cursor_init; plain data, may be copied
+    int list;
+    int slot;
+    int id;
+    unsigned long seq;
+    int next_id;//the record after id, a second place to resume if id is gone
+    unsigned long next_seq;
+};
+void backend_cursor_init(struct backend_cursor *cur, int list);
+int backend_cursor_next(struct backend_cursor *cur, struct backend_record out[], int max);//rows filled, 0 at the end
+//the next rows as the backend_get_*_text lines, whole lines only: at most max_rows, as many as fit in buf
+int backend_cursor_text(struct backend_cursor *cur, int max_rows, char *buf, int bufsize);
+//streams a whole listing through write, a chunk of lines per call, with bounded memory.
+//Returns 0, or -1 as soon as write returns nonzero.
+typedef int (*backend_writer)(void *ctx, const char *text, int len);
+int backend_write_list(int list, backend_writer write, void *ctx);
+int backend_list_size(int list);//rows in the listing right now
 void backend_get_availability_text(char *buf, int bufsize);
 
 
 void backend_save_all();//saves essential info to files before exiting the program
 
-int backend_get_shortest_path_text(int from, int to,char *buf, int bufsize);
+//journal fsync policies for backend_set_fsync_policy
+#define BACKEND_FSYNC_NONE 0   //leave flushing to the OS
+#define BACKEND_FSYNC_BATCH 1  //fsync once every few commits (default)
+#define BACKEND_FSYNC_ALWAYS 2 //fsync on every commit
+void backend_set_fsync_policy(int policy);
+void backend_commit();//appends queued mutations to journal.bin (backend_save_all calls this)
+void backend_checkpoint();//rewrites snapshot.bin and starts an empty journal
+int backend_export_csv();//writes confirmed.csv, waitlist.csv and meta.txt (older text format)
+void backend_set_async_persistence(int enabled);//1 = journal/snapshot writes happen on a background thread
+int backend_flush();//waits until everything saved so far is on disk; -1 if a write failed
+void backend_shutdown();//drops all records and routes, releasing their memory at once
+
+int backend_get_shortest_path_text(int from, int to,char *buf, int bufsize);//also lists alternative routes
+int backend_route_distance(int from, int to);//shortest distance, -1 if none; a fresh search, not the pricing cache
+
+//route pricing cache counters (see backend_get_route_cache_stats)
+struct backend_route_cache_stats {
+    unsigned long hits;
+    unsigned long misses;
+    int rows_cached;
+};
+void backend_get_route_cache_stats(struct backend_route_cache_stats *out);
+
+//record/edge allocator counters (see backend_get_alloc_stats)
+struct backend_alloc_stats {
+    long live_objects;
+    long slabs;
+    long bytes_reserved;
+    long bytes_wasted; //reserved but not holding a live object
+};
+void backend_get_alloc_stats(struct backend_alloc_stats *out);
+
+//hot-path counters, cumulative for the process; all zero when built with -DBACKEND_NO_STATS
+//histogram bucket i counts values v with 2^i <= v < 2^(i+1) (bucket 0 also holds 0)
+#define BACKEND_STATS_BUCKETS 32
+struct backend_stats {
+    unsigned long bookings, bookings_waitlisted, booking_failures;
+    unsigned long cancels, cancel_misses, promotions; //misses = unknown id
+    unsigned long lookups_direct, lookups_hash, hash_probes;
+    unsigned long dijkstra_runs, dijkstra_settled;
+    unsigned long journal_bytes, snapshot_bytes, commits, checkpoints;
+    unsigned long slab_allocs, slab_frees, slabs_created;
+    unsigned long book_ns[BACKEND_STATS_BUCKETS];   //backend_book latency
+    unsigned long cancel_ns[BACKEND_STATS_BUCKETS]; //backend_cancel latency
+    unsigned long probe_len[BACKEND_STATS_BUCKETS]; //hash slots inspected per lookup
+};
+void backend_get_stats(struct backend_stats *out);
+void backend_get_stats_text(char *buf, int bufsize);
+
+//replaces the built-in city graph: n cities, m undirected edges from[i]<->to[i] with weight[i]
+int backend_load_routes(int n, const int *from, const int *to, const int *weight, int m);
+int backend_city_count();//cities in the current route graph
+int backend_city_name(int city, char *buf, int bufsize);//-1 (and "N/A") if city is out of range
+
+//seats per leg (edge between two adjacent cities). A confirmed booking holds a seat on every leg
+//of the cheapest of up to 4 loopless paths that has room, and pays for that path's distance;
+//it is waitlisted if all are full. backend_get_shortest_path_text lists the candidates. Legs start unlimited and are
+//reset to unlimited by backend_load_routes; capacities are saved with the bookings and can be undone.
+//Returns -1 if the cities are not adjacent or seats is below current use.
+#define BACKEND_LEG_UNLIMITED -1
+int backend_set_leg_capacity(int from, int to, int seats);
+void backend_get_legs_text(char *buf, int bufsize);
 
 #endif
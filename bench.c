@@ -0,0 +1,807 @@
+/* bench.c
+   Workload benchmark for the backend.h API (Linux/POSIX, no raylib).
+   Preloads a dataset, then runs a weighted mix of backend_* calls from one or
+   more threads and reports throughput plus p50/p99/p999 latency per call.
+   Runs inside a fresh temporary directory so real data files are never touched.
+
+   Usage: bench [options]
+       -n ops        operations per worker thread (default 200000)
+       -t threads    worker threads running the mix (default 1)
+       -r readers    extra threads doing only backend_search while the mix runs
+       -d records    bookings made before timing starts (default 10000)
+       -p ratio      slots as a fraction of all bookings; < 1 puts the rest on
+                     the waitlist (default 2.0 = no waitlist)
+       -g cities     random route graph with this many cities (default: demo graph)
+       -m mix        weights book,cancel,modify,search,assign,route,avail,list,undo,save
+                     (default 30,15,10,35,5,2,3,0,0,0)
+       -f policy     journal fsync policy none|batch|always (default batch)
+       -a            background writer thread
+       -s seed       random seed
+       -b records    restart check: book this many records in one backend_book_batch,
+                     commit the journal, reload and verify every record came back
+       -T threads    thread scaling: the same run with 1, 2, 4 ... up to this many
+                     worker threads, then mixed ops/s and speedup over one thread
+       -P cities     shortest path: backend_route_distance against the original
+                     O(V^2) Dijkstra on the demo graph and on random graphs of
+                     1000 and this many cities
+       -I entries    reservation index: ns per insert, lookup (hit and miss) and
+                     delete with 10^3, 10^4 ... up to this many records (at most 10^7)
+       -S            run the built-in scenario suite instead of one run
+       -j            one JSON object per line instead of the table
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "backend.h"
+
+/* operations, in -m order */
+enum { OP_BOOK, OP_CANCEL, OP_MODIFY, OP_SEARCH, OP_ASSIGN, OP_ROUTE, OP_AVAIL, OP_LIST, OP_UNDO, OP_SAVE, OP_READER, OP_COUNT };
+static const char *OpName[OP_COUNT] = {
+    "book", "cancel", "modify", "search", "assign", "route", "avail", "list", "undo", "save", "reader_search"
+};
+#define MIX_OPS OP_READER /* operations selectable through -m */
+
+/* Log-linear latency histogram in nanoseconds: exact below 16 ns, then 8
+   sub-buckets per power of two (relative error under 12.5%) */
+#define HIST_SUB_BITS 3
+#define HIST_BUCKETS (16 + 60 * (1 << HIST_SUB_BITS))
+
+struct Hist {
+    unsigned long count[HIST_BUCKETS];
+    unsigned long total;
+    unsigned long max;
+    double sum;
+};
+
+struct Config {
+    const char *name;
+    long ops;
+    int threads;
+    int readers;
+    int records;
+    double slot_ratio;
+    int cities;
+    int mix[MIX_OPS];
+    int fsync_policy;
+    int async;
+    unsigned seed;
+};
+
+struct Worker {
+    pthread_t thread;
+    const struct Config *cfg;
+    unsigned seed;
+    struct Hist hist[OP_COUNT];
+};
+
+static atomic_int max_id;         /* highest reservation id handed out so far */
+static atomic_int readers_stop;
+static int city_count = 6;
+static int json_output = 0;
+static char *list_buf;            /* shared by OP_LIST, only used with -t 1 */
+#define LIST_BUF (4 * 1024 * 1024)
+
+/* ----------------- HISTOGRAM ----------------- */
+static int hist_bucket(unsigned long v) {
+    if (v < 16) return (int)v;
+    int msb = 63 - __builtin_clzl(v);
+    int sub = (int)(v >> (msb - HIST_SUB_BITS)) & ((1 << HIST_SUB_BITS) - 1);
+    int b = 16 + (msb - 4) * (1 << HIST_SUB_BITS) + sub;
+    return b < HIST_BUCKETS ? b : HIST_BUCKETS - 1;
+}
+
+/* Smallest value that falls into bucket b */
+static unsigned long hist_floor(int b) {
+    if (b < 16) return (unsigned long)b;
+    int msb = (b - 16) / (1 << HIST_SUB_BITS) + 4;
+    int sub = (b - 16) % (1 << HIST_SUB_BITS);
+    return (1UL << msb) + ((unsigned long)sub << (msb - HIST_SUB_BITS));
+}
+
+static void hist_add(struct Hist *h, unsigned long ns) {
+    h->count[hist_bucket(ns)]++;
+    h->total++;
+    h->sum += (double)ns;
+    if (ns > h->max) h->max = ns;
+}
+
+static void hist_merge(struct Hist *dst, const struct Hist *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) dst->count[i] += src->count[i];
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+static unsigned long hist_percentile(const struct Hist *h, double p) {
+    if (h->total == 0) return 0;
+    unsigned long rank = (unsigned long)(p * (double)h->total);
+    if (rank >= h->total) rank = h->total - 1;
+    unsigned long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->count[i];
+        if (seen > rank) return hist_floor(i);
+    }
+    return h->max;
+}
+
+/* ----------------- WORKLOAD ----------------- */
+static unsigned long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000UL + (unsigned long)ts.tv_nsec;
+}
+
+static unsigned rnd(unsigned *s) {
+    /* xorshift32 */
+    unsigned x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+static int random_id(unsigned *s) {
+    int hi = atomic_load(&max_id);
+    return hi < 1000 ? 1000 : 1000 + (int)(rnd(s) % (unsigned)(hi - 999));
+}
+
+static void do_book(unsigned *s) {
+    char name[16];
+    snprintf(name, sizeof(name), "pax%u", rnd(s) % 100000);
+    int from = (int)(rnd(s) % (unsigned)city_count);
+    int to = (int)(rnd(s) % (unsigned)city_count);
+    int id = backend_book(name, 18 + (int)(rnd(s) % 60), "9800000000", from, to);
+    int cur = atomic_load(&max_id);
+    while (id > cur && !atomic_compare_exchange_weak(&max_id, &cur, id)) {}
+}
+
+static void run_op(int op, unsigned *s) {
+    char buf[1024];
+    switch (op) {
+    case OP_BOOK: do_book(s); break;
+    case OP_CANCEL: backend_cancel(random_id(s)); break;
+    case OP_MODIFY: backend_modify(random_id(s), "renamed", 30, ""); break;
+    case OP_SEARCH:
+    case OP_READER: backend_search(random_id(s)); break;
+    case OP_ASSIGN:
+        backend_assign_route(random_id(s), (int)(rnd(s) % (unsigned)city_count), (int)(rnd(s) % (unsigned)city_count));
+        break;
+    case OP_ROUTE:
+        backend_get_shortest_path_text((int)(rnd(s) % (unsigned)city_count), (int)(rnd(s) % (unsigned)city_count), buf, sizeof(buf));
+        break;
+    case OP_AVAIL: backend_get_availability_text(buf, sizeof(buf)); break;
+    case OP_LIST: backend_get_confirmed_text(list_buf, LIST_BUF); break;
+    case OP_UNDO: backend_undo(); break;
+    case OP_SAVE: backend_save_all(); break;
+    }
+}
+
+static void *worker_main(void *arg) {
+    struct Worker *w = arg;
+    const struct Config *cfg = w->cfg;
+    int weight_sum = 0;
+    for (int i = 0; i < MIX_OPS; i++) weight_sum += cfg->mix[i];
+    for (long n = 0; n < cfg->ops; n++) {
+        int pick = (int)(rnd(&w->seed) % (unsigned)weight_sum);
+        int op = 0;
+        while (pick >= cfg->mix[op]) pick -= cfg->mix[op++];
+        unsigned long t0 = now_ns();
+        run_op(op, &w->seed);
+        hist_add(&w->hist[op], now_ns() - t0);
+    }
+    return NULL;
+}
+
+static void *reader_main(void *arg) {
+    struct Worker *w = arg;
+    while (!atomic_load_explicit(&readers_stop, memory_order_relaxed)) {
+        unsigned long t0 = now_ns();
+        run_op(OP_READER, &w->seed);
+        hist_add(&w->hist[OP_READER], now_ns() - t0);
+    }
+    return NULL;
+}
+
+/* Connected random graph: a ring plus about one extra edge per city. Returns
+   the number of edges (arrays owned by the caller), -1 if out of memory. */
+static int random_graph(int n, unsigned *s, int **from, int **to, int **weight) {
+    int m = n > 1 ? 2 * n : 0;
+    *from = malloc(sizeof(int) * (m > 0 ? m : 1));
+    *to = malloc(sizeof(int) * (m > 0 ? m : 1));
+    *weight = malloc(sizeof(int) * (m > 0 ? m : 1));
+    if (!*from || !*to || !*weight) return -1;
+    for (int i = 0; i < m; i++) {
+        (*from)[i] = i < n ? i : (int)(rnd(s) % (unsigned)n);
+        (*to)[i] = i < n ? (i + 1) % n : (int)(rnd(s) % (unsigned)n);
+        (*weight)[i] = 1 + (int)(rnd(s) % 20);
+    }
+    return m;
+}
+
+static int load_random_graph(int n, unsigned *s) {
+    int *from, *to, *weight;
+    int m = random_graph(n, s, &from, &to, &weight);
+    int rc = m < 0 ? -1 : backend_load_routes(n, from, to, weight, m);
+    free(from); free(to); free(weight);
+    return rc;
+}
+
+/* ----------------- REPORT ----------------- */
+static void report(const struct Config *cfg, const struct Hist *h, double seconds) {
+    if (!json_output) {
+        printf("\n== %s: %d thread(s), %d reader(s), %ld ops/thread, %d records, slot ratio %.2f, %d cities, fsync %d%s\n",
+               cfg->name, cfg->threads, cfg->readers, cfg->ops, cfg->records, cfg->slot_ratio, city_count,
+               cfg->fsync_policy, cfg->async ? ", async" : "");
+        printf("%-14s %10s %12s %10s %10s %10s %10s %10s\n", "op", "count", "ops/s", "mean_ns", "p50_ns", "p99_ns", "p999_ns", "max_ns");
+    }
+    for (int op = 0; op < OP_COUNT; op++) {
+        const struct Hist *x = &h[op];
+        if (x->total == 0) continue;
+        double rate = seconds > 0 ? (double)x->total / seconds : 0;
+        unsigned long p50 = hist_percentile(x, 0.50), p99 = hist_percentile(x, 0.99), p999 = hist_percentile(x, 0.999);
+        if (json_output) {
+            printf("{\"scenario\":\"%s\",\"op\":\"%s\",\"threads\":%d,\"readers\":%d,\"records\":%d,\"slot_ratio\":%.3f,"
+                   "\"cities\":%d,\"fsync\":%d,\"async\":%d,\"count\":%lu,\"ops_per_sec\":%.0f,\"mean_ns\":%.0f,"
+                   "\"p50_ns\":%lu,\"p99_ns\":%lu,\"p999_ns\":%lu,\"max_ns\":%lu}\n",
+                   cfg->name, OpName[op], cfg->threads, cfg->readers, cfg->records, cfg->slot_ratio, city_count,
+                   cfg->fsync_policy, cfg->async, x->total, rate, x->sum / (double)x->total, p50, p99, p999, x->max);
+        } else {
+            printf("%-14s %10lu %12.0f %10.0f %10lu %10lu %10lu %10lu\n",
+                   OpName[op], x->total, rate, x->sum / (double)x->total, p50, p99, p999, x->max);
+        }
+    }
+    if (json_output) {
+        printf("{\"scenario\":\"%s\",\"op\":\"all\",\"seconds\":%.6f,\"ops_per_sec\":%.0f}\n",
+               cfg->name, seconds, seconds > 0 ? (double)cfg->ops * cfg->threads / seconds : 0);
+    } else {
+        printf("total %.3f s, %.0f mixed ops/s\n", seconds, seconds > 0 ? (double)cfg->ops * cfg->threads / seconds : 0);
+    }
+    fflush(stdout);
+}
+
+/* ----------------- RUN ----------------- */
+static void remove_data_files() {
+    const char *files[] = { "snapshot.bin", "snapshot.bin.tmp", "journal.bin", "confirmed.csv",
+                            "waitlist.csv", "meta.txt", "confirmed.csv.tmp", "waitlist.csv.tmp" };
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) unlink(files[i]);
+}
+
+/* *seconds (if given) gets the wall time of the timed part */
+static int run_config(const struct Config *cfg, double *seconds_out) {
+    remove_data_files();
+    backend_init();
+    backend_set_fsync_policy(cfg->fsync_policy);
+    unsigned seed = cfg->seed ? cfg->seed : 1;
+    city_count = 6;
+    if (cfg->cities > 0) {
+        if (load_random_graph(cfg->cities, &seed) != 0) {
+            fprintf(stderr, "could not build a %d-city graph\n", cfg->cities);
+            return -1;
+        }
+        city_count = cfg->cities;
+    }
+
+    /* slots sized against everything that will be booked */
+    double bookings = cfg->records;
+    int weight_sum = 0;
+    for (int i = 0; i < MIX_OPS; i++) weight_sum += cfg->mix[i];
+    if (weight_sum <= 0) {
+        fprintf(stderr, "empty operation mix\n");
+        return -1;
+    }
+    bookings += (double)cfg->ops * cfg->threads * cfg->mix[OP_BOOK] / weight_sum;
+    int slots = (int)(bookings * cfg->slot_ratio);
+    backend_change_slots(slots > 0 ? slots : 1);
+
+    atomic_store(&max_id, 999);
+    for (int i = 0; i < cfg->records; i++) do_book(&seed);
+    backend_save_all();
+    if (cfg->async) backend_set_async_persistence(1);
+
+    int nw = cfg->threads + cfg->readers;
+    struct Worker *w = calloc((size_t)nw, sizeof(struct Worker));
+    if (!w) return -1;
+    atomic_store(&readers_stop, 0);
+    for (int i = 0; i < nw; i++) {
+        w[i].cfg = cfg;
+        w[i].seed = seed + 7919u * (unsigned)(i + 1);
+    }
+    for (int i = 0; i < cfg->readers; i++) pthread_create(&w[cfg->threads + i].thread, NULL, reader_main, &w[cfg->threads + i]);
+    unsigned long t0 = now_ns();
+    for (int i = 0; i < cfg->threads; i++) pthread_create(&w[i].thread, NULL, worker_main, &w[i]);
+    for (int i = 0; i < cfg->threads; i++) pthread_join(w[i].thread, NULL);
+    double seconds = (double)(now_ns() - t0) / 1e9;
+    atomic_store(&readers_stop, 1);
+    for (int i = 0; i < cfg->readers; i++) pthread_join(w[cfg->threads + i].thread, NULL);
+
+    struct Hist *total = calloc(OP_COUNT, sizeof(struct Hist));
+    if (total) {
+        for (int i = 0; i < nw; i++)
+            for (int op = 0; op < OP_COUNT; op++) hist_merge(&total[op], &w[i].hist[op]);
+        report(cfg, total, seconds);
+    }
+    if (seconds_out) *seconds_out = seconds;
+    free(total);
+    free(w);
+    backend_flush();
+    backend_set_async_persistence(0);
+    backend_shutdown();
+    remove_data_files();
+    return 0;
+}
+
+/* One large batch, journal only (no checkpoint), then a restart that has to
+   replay every record; exits nonzero if any are missing */
+static int run_batch_restart(int n) {
+    remove_data_files();
+    backend_init();
+    backend_change_slots(n);
+    struct backend_booking *reqs = malloc(sizeof(struct backend_booking) * (size_t)n);
+    int *ids = malloc(sizeof(int) * (size_t)n);
+    if (!reqs || !ids) { free(reqs); free(ids); backend_shutdown(); return -1; }
+    unsigned seed = 1;
+    for (int i = 0; i < n; i++) {
+        reqs[i].name = "Batch";
+        reqs[i].age = 18 + (int)(rnd(&seed) % 60);
+        reqs[i].contact = "555-0100";
+        reqs[i].route_from = (int)(rnd(&seed) % 6);
+        reqs[i].route_to = (reqs[i].route_from + 1 + (int)(rnd(&seed) % 5)) % 6;
+    }
+    unsigned long t0 = now_ns();
+    int booked = backend_book_batch(reqs, n, ids);
+    backend_commit();
+    backend_flush();
+    double book_s = (double)(now_ns() - t0) / 1e9;
+    int before = backend_list_size(BACKEND_LIST_CONFIRMED) + backend_list_size(BACKEND_LIST_WAITLIST);
+    backend_shutdown();
+
+    t0 = now_ns();
+    backend_init();
+    double load_s = (double)(now_ns() - t0) / 1e9;
+    int after = backend_list_size(BACKEND_LIST_CONFIRMED) + backend_list_size(BACKEND_LIST_WAITLIST);
+    int missing = 0;
+    for (int i = 0; i < n; i++) missing += ids[i] > 0 && backend_search(ids[i]) == 0;
+    int ok = booked == n && before == n && after == n && missing == 0;
+    if (json_output) {
+        printf("{\"scenario\":\"batch_restart\",\"records\":%d,\"booked\":%d,\"reloaded\":%d,\"missing\":%d,"
+               "\"book_seconds\":%.6f,\"reload_seconds\":%.6f,\"ok\":%d}\n", n, booked, after, missing, book_s, load_s, ok);
+    } else {
+        printf("\n== batch_restart: %d records in one batch\n", n);
+        printf("booked %d in %.3f s, reloaded %d in %.3f s, %d missing: %s\n", booked, book_s, after, load_s, missing, ok ? "ok" : "FAILED");
+    }
+    fflush(stdout);
+    free(reqs);
+    free(ids);
+    backend_shutdown();
+    remove_data_files();
+    return ok ? 0 : -1;
+}
+
+/* cfg with 1, 2, 4 ... max worker threads (max itself last); ops per thread stay
+   fixed, so perfect scaling keeps the wall time flat */
+static int run_thread_scaling(const struct Config *base, int max) {
+    int counts[32], runs = 0;
+    for (int t = 1; t < max && runs < 31; t *= 2) counts[runs++] = t;
+    counts[runs++] = max;
+    double rate[32];
+    int rc = 0;
+    for (int i = 0; i < runs && rc == 0; i++) {
+        struct Config c = *base;
+        c.name = "scaling";
+        c.threads = counts[i];
+        double seconds = 0;
+        rc = run_config(&c, &seconds);
+        rate[i] = seconds > 0 ? (double)c.ops * c.threads / seconds : 0;
+    }
+    if (rc != 0) return rc;
+    if (!json_output) printf("\n== scaling summary\n%-8s %14s %8s\n", "threads", "mixed ops/s", "speedup");
+    for (int i = 0; i < runs; i++) {
+        double speedup = rate[0] > 0 ? rate[i] / rate[0] : 0;
+        if (json_output) printf("{\"scenario\":\"scaling\",\"op\":\"all\",\"threads\":%d,\"ops_per_sec\":%.0f,\"speedup\":%.2f}\n", counts[i], rate[i], speedup);
+        else printf("%-8d %14.0f %8.2f\n", counts[i], rate[i], speedup);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+/* ----------------- SHORTEST PATH ----------------- */
+/* The Dijkstra the backend used before the CSR graph: edge lists scattered
+   over the heap, three arrays allocated per call and a scan of every city to
+   pick the next one, so O(V^2) per query. Kept here as the baseline. */
+struct RefEdge {
+    int to, weight;
+    struct RefEdge *next;
+};
+
+struct RefGraph {
+    int n;
+    struct RefEdge **adj;
+};
+
+static int ref_graph_build(struct RefGraph *g, int n, const int *from, const int *to, const int *weight, int m) {
+    g->n = n;
+    g->adj = calloc((size_t)n, sizeof(struct RefEdge *));
+    if (!g->adj) return -1;
+    for (int i = 0; i < m; i++) {
+        for (int side = 0; side < 2; side++) {
+            struct RefEdge *e = malloc(sizeof(struct RefEdge));
+            if (!e) return -1;
+            int u = side ? to[i] : from[i];
+            e->to = side ? from[i] : to[i];
+            e->weight = weight[i];
+            e->next = g->adj[u];
+            g->adj[u] = e;
+        }
+    }
+    return 0;
+}
+
+static void ref_graph_free(struct RefGraph *g) {
+    for (int u = 0; g->adj && u < g->n; u++) {
+        for (struct RefEdge *e = g->adj[u], *next; e; e = next) {
+            next = e->next;
+            free(e);
+        }
+    }
+    free(g->adj);
+    g->adj = NULL;
+}
+
+static int ref_dijkstra(const struct RefGraph *g, int src, int dest) {
+    int n = g->n;
+    int *dist = malloc(sizeof(int) * n);
+    int *prev = malloc(sizeof(int) * n);
+    int *visited = malloc(sizeof(int) * n);
+    if (!dist || !prev || !visited) {
+        free(dist); free(prev); free(visited);
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        dist[i] = INT_MAX;
+        prev[i] = -1;
+        visited[i] = 0;
+    }
+    dist[src] = 0;
+    for (int count = 0; count < n; count++) {
+        int u = -1;
+        int best = INT_MAX;
+        for (int i = 0; i < n; i++) {
+            if (!visited[i] && dist[i] < best) {
+                best = dist[i];
+                u = i;
+            }
+        }
+        if (u == -1) break;
+        visited[u] = 1;
+        if (u == dest) break;
+        for (struct RefEdge *e = g->adj[u]; e; e = e->next) {
+            int v = e->to;
+            if (!visited[v] && dist[u] + e->weight < dist[v]) {
+                dist[v] = dist[u] + e->weight;
+                prev[v] = u;
+            }
+        }
+    }
+    int d = dist[dest] == INT_MAX ? -1 : dist[dest];
+    free(dist); free(prev); free(visited);
+    return d;
+}
+
+/* Same random (from, to) pairs through both searches on one graph; the
+   reference gets fewer queries on big graphs so it ends in seconds. Returns -1
+   if the two disagree on a distance. */
+static int path_bench_graph(const char *name, int n, const int *from, const int *to, const int *weight, int m) {
+    struct RefGraph ref;
+    if (backend_load_routes(n, from, to, weight, m) != 0 || ref_graph_build(&ref, n, from, to, weight, m) != 0) {
+        fprintf(stderr, "could not load the %s graph\n", name);
+        return -1;
+    }
+    int queries = 2000;
+    long work = (long)n * n;
+    int ref_queries = work > 2000000000L / queries ? (int)(2000000000L / work) : queries;
+    if (ref_queries < 3) ref_queries = 3;
+    int *pairs = malloc(sizeof(int) * 2 * (size_t)queries);
+    int *dist = malloc(sizeof(int) * (size_t)queries);
+    if (!pairs || !dist) { free(pairs); free(dist); ref_graph_free(&ref); return -1; }
+    unsigned seed = 1;
+    for (int i = 0; i < 2 * queries; i++) pairs[i] = (int)(rnd(&seed) % (unsigned)n);
+
+    backend_route_distance(pairs[0], pairs[1]); /* builds the CSR copy outside the timing */
+    unsigned long t0 = now_ns();
+    for (int i = 0; i < queries; i++) dist[i] = backend_route_distance(pairs[2 * i], pairs[2 * i + 1]);
+    double heap_ns = (double)(now_ns() - t0) / queries;
+    int mismatches = 0;
+    t0 = now_ns();
+    for (int i = 0; i < ref_queries; i++) mismatches += ref_dijkstra(&ref, pairs[2 * i], pairs[2 * i + 1]) != dist[i];
+    double ref_ns = (double)(now_ns() - t0) / ref_queries;
+
+    if (json_output) {
+        printf("{\"scenario\":\"shortest_path\",\"graph\":\"%s\",\"cities\":%d,\"edges\":%d,\"queries\":%d,"
+               "\"heap_csr_ns\":%.0f,\"ref_queries\":%d,\"linear_scan_ns\":%.0f,\"speedup\":%.1f,\"mismatches\":%d}\n",
+               name, n, m, queries, heap_ns, ref_queries, ref_ns, heap_ns > 0 ? ref_ns / heap_ns : 0, mismatches);
+    } else {
+        printf("%-10s %8d %8d %14.0f %16.0f %10.1f%s\n", name, n, m, heap_ns, ref_ns,
+               heap_ns > 0 ? ref_ns / heap_ns : 0, mismatches ? "  MISMATCH" : "");
+    }
+    fflush(stdout);
+    free(pairs);
+    free(dist);
+    ref_graph_free(&ref);
+    return mismatches ? -1 : 0;
+}
+
+/* The demo graph, then random graphs of 1000 and max cities */
+static int run_path_bench(int max) {
+    static const int demo_from[] = { 0, 0, 1, 1, 2, 4, 3 };
+    static const int demo_to[] = { 1, 2, 2, 3, 4, 5, 5 };
+    static const int demo_weight[] = { 5, 8, 3, 7, 6, 2, 10 };
+    remove_data_files();
+    backend_init();
+    if (!json_output) {
+        printf("\n== shortest path: ns per query, heap + CSR vs the original linear scan\n");
+        printf("%-10s %8s %8s %14s %16s %10s\n", "graph", "cities", "edges", "heap_csr_ns", "linear_scan_ns", "speedup");
+    }
+    int rc = path_bench_graph("demo", 6, demo_from, demo_to, demo_weight, 7);
+    int sizes[2] = { 1000, max };
+    for (int i = 0; i < 2 && rc == 0; i++) {
+        if (i == 1 && max <= 1000) break;
+        int *from, *to, *weight;
+        unsigned seed = 1;
+        int m = random_graph(sizes[i], &seed, &from, &to, &weight);
+        rc = m < 0 ? -1 : path_bench_graph("random", sizes[i], from, to, weight, m);
+        free(from); free(to); free(weight);
+    }
+    backend_shutdown();
+    remove_data_files();
+    return rc;
+}
+
+/* ----------------- RESERVATION INDEX ----------------- */
+/* Per-operation cost of the reservation index as it fills. Booked ids are dense
+   and land in the direct table; ids beyond its range go to the hash table and
+   can only come from an imported file, so hash inserts are timed through a CSV
+   import (parsing included). Lookups use random present and absent ids,
+   deletes cancel every record in random order. Batches keep the lock and
+   journal overhead per record small. */
+#define INDEX_CHUNK 1000       /* records per backend_book_batch / backend_cancel_batch */
+#define INDEX_LOOKUPS 1000000  /* lookups timed per size */
+#define INDEX_MAX 10000000
+
+/* Spread over the ids past the direct range; INDEX_MAX of them fit in an int */
+static int hash_range_id(int i) {
+    return 1100000000 + i * 97;
+}
+
+static void shuffle(int *a, int n, unsigned *s) {
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)(rnd(s) % (unsigned)(i + 1));
+        int t = a[i]; a[i] = a[j]; a[j] = t;
+    }
+}
+
+/* Fills ids[0..n) with live records: booked, or imported from confirmed.csv.
+   Returns ns per insert, -1 on failure. */
+static double index_fill(int n, int hashed, int *ids) {
+    unsigned long t0, spent = 0;
+    if (hashed) {
+        FILE *f = fopen("confirmed.csv", "w");
+        FILE *m = fopen("meta.txt", "w");
+        if (!f || !m) { if (f) fclose(f); if (m) fclose(m); return -1; }
+        for (int i = 0; i < n; i++) {
+            ids[i] = hash_range_id(i);
+            fprintf(f, "%d,Index,30,555-0100,%d,0,1,500\n", ids[i], i + 1);
+        }
+        fprintf(m, "1000\n%d\n%d\n", n, n);
+        fclose(f);
+        fclose(m);
+        t0 = now_ns();
+        backend_init();
+        spent = now_ns() - t0;
+        backend_set_fsync_policy(BACKEND_FSYNC_NONE);
+    } else {
+        backend_init();
+        backend_set_fsync_policy(BACKEND_FSYNC_NONE);
+        backend_change_slots(n);
+        struct backend_booking reqs[INDEX_CHUNK];
+        for (int i = 0; i < INDEX_CHUNK; i++) {
+            reqs[i].name = "Index";
+            reqs[i].age = 30;
+            reqs[i].contact = "555-0100";
+            reqs[i].route_from = 0;
+            reqs[i].route_to = 1;
+        }
+        for (int off = 0; off < n; off += INDEX_CHUNK) {
+            int c = n - off < INDEX_CHUNK ? n - off : INDEX_CHUNK;
+            t0 = now_ns();
+            backend_book_batch(reqs, c, ids + off);
+            spent += now_ns() - t0;
+            backend_commit(); /* keeps the journal buffer small, untimed */
+        }
+    }
+    return backend_list_size(BACKEND_LIST_CONFIRMED) == n ? (double)spent / n : -1;
+}
+
+/* ns[] gets insert, lookup, miss and delete; -1 if a record went missing */
+static int index_bench_size(int n, int hashed, double ns[4]) {
+    int *ids = malloc(sizeof(int) * (size_t)n);
+    int *probe = malloc(sizeof(int) * INDEX_LOOKUPS);
+    int *results = malloc(sizeof(int) * INDEX_CHUNK);
+    int rc = -1;
+    remove_data_files();
+    if (!ids || !probe || !results || (ns[0] = index_fill(n, hashed, ids)) < 0) goto done;
+
+    unsigned seed = 1;
+    for (int pass = 1; pass <= 2; pass++) {
+        /* pass 1: present ids; pass 2: absent ones, next to a present id for the hash */
+        for (int i = 0; i < INDEX_LOOKUPS; i++) {
+            int k = (int)(rnd(&seed) % (unsigned)n);
+            probe[i] = pass == 1 ? ids[k] : hashed ? ids[k] + 1 : ids[n - 1] + 1 + k;
+        }
+        int found = 0;
+        unsigned long t0 = now_ns();
+        for (int i = 0; i < INDEX_LOOKUPS; i++) found += backend_search(probe[i]) != 0;
+        ns[pass] = (double)(now_ns() - t0) / INDEX_LOOKUPS;
+        if (found != (pass == 1 ? INDEX_LOOKUPS : 0)) goto done;
+    }
+
+    shuffle(ids, n, &seed);
+    unsigned long spent = 0;
+    int cancelled = 0;
+    for (int off = 0; off < n; off += INDEX_CHUNK) {
+        int c = n - off < INDEX_CHUNK ? n - off : INDEX_CHUNK;
+        unsigned long t0 = now_ns();
+        cancelled += backend_cancel_batch(ids + off, c, results);
+        spent += now_ns() - t0;
+        backend_commit();
+    }
+    ns[3] = (double)spent / n;
+    rc = cancelled == n && backend_list_size(BACKEND_LIST_CONFIRMED) == 0 ? 0 : -1;
+done:
+    backend_shutdown();
+    remove_data_files();
+    free(ids);
+    free(probe);
+    free(results);
+    return rc;
+}
+
+static int run_index_bench(int max) {
+    if (max > INDEX_MAX) {
+        fprintf(stderr, "the index benchmark goes up to %d records\n", INDEX_MAX);
+        return -1;
+    }
+    if (!json_output) {
+        printf("\n== reservation index: ns per operation (hash inserts include the CSV import)\n");
+        printf("%-7s %10s %10s %10s %10s %10s\n", "index", "entries", "insert_ns", "lookup_ns", "miss_ns", "delete_ns");
+    }
+    for (long n = 1000; n <= max; n *= 10) {
+        for (int hashed = 0; hashed < 2; hashed++) {
+            double ns[4];
+            const char *name = hashed ? "hash" : "direct";
+            if (index_bench_size((int)n, hashed, ns) != 0) {
+                fprintf(stderr, "%s index lost records at %ld entries\n", name, n);
+                return -1;
+            }
+            if (json_output) {
+                printf("{\"scenario\":\"index\",\"index\":\"%s\",\"entries\":%ld,\"insert_ns\":%.0f,"
+                       "\"lookup_ns\":%.0f,\"miss_ns\":%.0f,\"delete_ns\":%.0f}\n", name, n, ns[0], ns[1], ns[2], ns[3]);
+            } else {
+                printf("%-7s %10ld %10.0f %10.0f %10.0f %10.0f\n", name, n, ns[0], ns[1], ns[2], ns[3]);
+            }
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
+
+static int parse_mix(const char *s, int mix[MIX_OPS]) {
+    for (int i = 0; i < MIX_OPS; i++) mix[i] = 0;
+    for (int i = 0; i < MIX_OPS && *s; i++) {
+        char *end;
+        long v = strtol(s, &end, 10);
+        if (end == s || v < 0) return -1;
+        mix[i] = (int)v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct Config cfg = { "custom", 200000, 1, 0, 10000, 2.0, 0, { 30, 15, 10, 35, 5, 2, 3, 0, 0, 0 }, BACKEND_FSYNC_BATCH, 0, 1 };
+    int suite = 0, batch_restart = 0, scaling = 0, path_cities = 0, index_entries = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:r:d:p:g:m:f:as:b:T:P:I:Sj")) != -1) {
+        switch (opt) {
+        case 'n': cfg.ops = atol(optarg); break;
+        case 't': cfg.threads = atoi(optarg); break;
+        case 'r': cfg.readers = atoi(optarg); break;
+        case 'd': cfg.records = atoi(optarg); break;
+        case 'p': cfg.slot_ratio = atof(optarg); break;
+        case 'g': cfg.cities = atoi(optarg); break;
+        case 'm':
+            if (parse_mix(optarg, cfg.mix) != 0) { fprintf(stderr, "bad mix %s\n", optarg); return 2; }
+            break;
+        case 'f':
+            if (strcmp(optarg, "none") == 0) cfg.fsync_policy = BACKEND_FSYNC_NONE;
+            else if (strcmp(optarg, "batch") == 0) cfg.fsync_policy = BACKEND_FSYNC_BATCH;
+            else if (strcmp(optarg, "always") == 0) cfg.fsync_policy = BACKEND_FSYNC_ALWAYS;
+            else { fprintf(stderr, "unknown fsync policy %s\n", optarg); return 2; }
+            break;
+        case 'a': cfg.async = 1; break;
+        case 's': cfg.seed = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'b': batch_restart = atoi(optarg); break;
+        case 'T': scaling = atoi(optarg); break;
+        case 'P': path_cities = atoi(optarg); break;
+        case 'I': index_entries = atoi(optarg); break;
+        case 'S': suite = 1; break;
+        case 'j': json_output = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-n ops] [-t threads] [-r readers] [-d records] [-p slot_ratio] [-g cities]\n"
+                            "       [-m book,cancel,modify,search,assign,route,avail,list,undo,save] [-f none|batch|always] [-a] [-s seed] [-b records] [-T threads] [-P cities] [-I entries] [-S] [-j]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (cfg.threads < 1 || cfg.readers < 0 || cfg.ops < 1 || cfg.records < 0) {
+        fprintf(stderr, "threads and ops must be positive\n");
+        return 2;
+    }
+    if (cfg.mix[OP_LIST] > 0 && (cfg.threads > 1 || scaling > 1)) {
+        fprintf(stderr, "the list operation needs -t 1\n");
+        return 2;
+    }
+    list_buf = malloc(LIST_BUF);
+
+    char dir[] = "/tmp/urs-bench-XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    int rc = 0;
+    if (batch_restart > 0) {
+        rc = run_batch_restart(batch_restart);
+    } else if (scaling > 0) {
+        rc = run_thread_scaling(&cfg, scaling);
+    } else if (path_cities > 0) {
+        rc = run_path_bench(path_cities);
+    } else if (index_entries > 0) {
+        rc = run_index_bench(index_entries);
+    } else if (!suite) {
+        rc = run_config(&cfg, NULL);
+    } else {
+        /* each scenario changes one dimension of the default run */
+        struct Config s[8];
+        for (int i = 0; i < 8; i++) s[i] = cfg;
+        s[0].name = "baseline";
+        s[1].name = "read_heavy";     s[1].mix[OP_BOOK] = 5; s[1].mix[OP_CANCEL] = 2; s[1].mix[OP_SEARCH] = 90;
+        s[2].name = "write_heavy";    s[2].mix[OP_BOOK] = 50; s[2].mix[OP_CANCEL] = 30; s[2].mix[OP_SEARCH] = 10;
+        s[3].name = "waitlist";       s[3].slot_ratio = 0.5;
+        s[4].name = "big_graph";      s[4].cities = 5000; s[4].mix[OP_ROUTE] = 10;
+        s[5].name = "big_dataset";    s[5].records = 1000000;
+        s[6].name = "fsync_always";   s[6].fsync_policy = BACKEND_FSYNC_ALWAYS; s[6].mix[OP_SAVE] = 20;
+        s[6].ops = cfg.ops / 10 > 0 ? cfg.ops / 10 : 1;
+        s[7].name = "readers";        s[7].readers = 2; s[7].threads = 2;
+        for (int i = 0; i < 8 && rc == 0; i++) rc = run_config(&s[i], NULL);
+        /* write-heavy mix from one thread up to one per CPU */
+        if (rc == 0) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            rc = run_thread_scaling(&s[2], cpus > 1 ? (int)cpus : 2);
+        }
+        /* more than one JREC_MAX_LEN journal record */
+        if (rc == 0) rc = run_batch_restart(700000);
+        if (rc == 0) rc = run_path_bench(10000);
+        if (rc == 0) rc = run_index_bench(1000000);
+    }
+
+    if (chdir("/tmp") == 0) rmdir(dir);
+    free(list_buf);
+    return rc == 0 ? 0 : 1;
+}
@@ -11,7 +11,15 @@
 #include "backend.h"
 
 #define SCREEN_W 900
-#define SCREEN_H 650
+#define SCREEN_H 820
+
+/* buttons, in grid order; the index is also what a click dispatches on */
+enum {
+    ACT_BOOK, ACT_CANCEL, ACT_MODIFY, ACT_SEARCH,
+    ACT_CONFIRMED, ACT_WAITLIST, ACT_SLOTMAP, ACT_AVAILABILITY,
+    ACT_UNDO, ACT_REDO, ACT_CHANGE_SLOTS, ACT_ASSIGN_ROUTE, ACT_SHORTEST_PATH, ACT_EXIT,
+    ACT_COUNT
+};
 
 typedef struct {
     Rectangle rec;
@@ -106,207 +114,433 @@ static int modal_input(const char *title, const char *fields[], int field_count,
     return 0;
 }
 
+/* ----------------- LIST VIEW ----------------- */
+/* Scrolling view of one backend listing. Only the rows on screen are fetched,
+   through a backend_cursor, and nothing is formatted for the rest. The cursor
+   sitting before every LIST_MARK_ROWS-th row is kept, so a scroll walks at most
+   one stretch of the list instead of starting from the head. */
+#define LIST_X 40
+#define LIST_Y 300
+#define LIST_W (SCREEN_W-80)
+#define LIST_H (SCREEN_H-130-LIST_Y-15)
+#define LIST_ROW_H 20
+#define LIST_ROWS ((LIST_H-50)/LIST_ROW_H)
+#define LIST_MARK_ROWS 256
+
+static struct {
+    int list;  /* BACKEND_LIST_* on display */
+    int top;   /* index of the first row on screen */
+    int count; /* rows in the listing at the last fetch */
+    struct backend_cursor *marks; /* marks[i] sits before row i*LIST_MARK_ROWS */
+    int mark_count, mark_cap;
+    struct backend_record rows[LIST_ROWS];
+    int row_count;
+} view;
+
+/* Moves cur past n rows; returns how many there were */
+static int list_skip(struct backend_cursor *cur, int n) {
+    if (cur->list == BACKEND_LIST_SLOTS) { /* slot rows are numbered, no walk needed */
+        cur->slot += n;
+        return n;
+    }
+    static struct backend_record scratch[128];
+    int done = 0;
+    while (done < n) {
+        int want = n - done < 128 ? n - done : 128;
+        int got = backend_cursor_next(cur, scratch, want);
+        done += got;
+        if (got < want) break;
+    }
+    return done;
+}
+
+/* Refetches the rows on screen, clamping the scroll position to the listing */
+static void list_fetch(void) {
+    view.count = backend_list_size(view.list);
+    if (view.top > view.count - LIST_ROWS) view.top = view.count - LIST_ROWS;
+    if (view.top < 0) view.top = 0;
+    if (view.mark_count == 0) {
+        if (!view.marks) {
+            view.mark_cap = 16;
+            view.marks = malloc(view.mark_cap * sizeof(*view.marks));
+            if (!view.marks) { view.row_count = 0; return; }
+        }
+        backend_cursor_init(&view.marks[0], view.list);
+        view.mark_count = 1;
+    }
+    int m = view.top / LIST_MARK_ROWS;
+    while (view.mark_count <= m) {
+        struct backend_cursor cur = view.marks[view.mark_count-1];
+        if (list_skip(&cur, LIST_MARK_ROWS) < LIST_MARK_ROWS) break;
+        if (view.mark_count == view.mark_cap) {
+            struct backend_cursor *grown = realloc(view.marks, 2 * view.mark_cap * sizeof(*view.marks));
+            if (!grown) break;
+            view.marks = grown;
+            view.mark_cap *= 2;
+        }
+        view.marks[view.mark_count++] = cur;
+    }
+    if (m >= view.mark_count) m = view.mark_count - 1;
+    struct backend_cursor cur = view.marks[m];
+    list_skip(&cur, view.top - m*LIST_MARK_ROWS);
+    view.row_count = backend_cursor_next(&cur, view.rows, LIST_ROWS);
+}
+
+/* After a change to the records the marks no longer sit at their row numbers */
+static void list_reload(void) {
+    view.mark_count = 0;
+    list_fetch();
+}
+
+static void list_show(int list) {
+    view.list = list;
+    view.top = 0;
+    list_reload();
+}
+
+/* Returns 1 if the view moved */
+static int list_scroll(int delta) {
+    int last = view.count > LIST_ROWS ? view.count - LIST_ROWS : 0;
+    long top = (long)view.top + delta;
+    top = top < 0 ? 0 : top > last ? last : top;
+    if (top == view.top) return 0;
+    view.top = (int)top;
+    list_fetch();
+    return 1;
+}
+
+static void list_draw(void) {
+    const char *titles[] = {"", "Confirmed", "Waitlist", "Slot Map"};
+    char line[128];
+    int x = LIST_X + 10, y = LIST_Y + 8;
+
+    DrawRectangle(LIST_X, LIST_Y, LIST_W, LIST_H, (Color){14,14,18,255});
+    DrawRectangleLines(LIST_X, LIST_Y, LIST_W, LIST_H, DARKGRAY);
+    if (view.count > 0)
+        snprintf(line, sizeof(line), "%s: %d-%d of %d   (wheel, arrows, PgUp/PgDn, Home/End)",
+                 titles[view.list], view.top + 1, view.top + view.row_count, view.count);
+    else
+        snprintf(line, sizeof(line), "%s: empty", titles[view.list]);
+    DrawText(line, x, y, 18, LIGHTGRAY);
+
+    y += 26;
+    if (view.list == BACKEND_LIST_SLOTS) {
+        DrawText("Slot", x, y, 16, GRAY);
+        DrawText("ID", x + 80, y, 16, GRAY);
+        DrawText("Name", x + 160, y, 16, GRAY);
+    } else {
+        DrawText("ID", x, y, 16, GRAY);
+        DrawText("Name", x + 80, y, 16, GRAY);
+        DrawText("Age", x + 280, y, 16, GRAY);
+        DrawText("Contact", x + 330, y, 16, GRAY);
+        DrawText(view.list == BACKEND_LIST_CONFIRMED ? "Slot" : "Pos", x + 470, y, 16, GRAY);
+        DrawText("Route", x + 530, y, 16, GRAY);
+        DrawText("Cost", x + 710, y, 16, GRAY);
+    }
+
+    for (int i = 0; i < view.row_count; i++) {
+        const struct backend_record *r = &view.rows[i];
+        int ry = LIST_Y + 50 + i*LIST_ROW_H;
+        Color c = r->group_id ? SKYBLUE : RAYWHITE;
+        if (view.list == BACKEND_LIST_SLOTS) {
+            snprintf(line, sizeof(line), "%d", r->slot_number);
+            DrawText(line, x, ry, 16, RAYWHITE);
+            if (!r->reservation_id) {
+                DrawText("Available", x + 80, ry, 16, GRAY);
+                continue;
+            }
+            snprintf(line, sizeof(line), "%d", r->reservation_id);
+            DrawText(line, x + 80, ry, 16, c);
+            snprintf(line, sizeof(line), "%.30s", r->name);
+            DrawText(line, x + 160, ry, 16, c);
+            continue;
+        }
+        snprintf(line, sizeof(line), "%d", r->reservation_id);
+        DrawText(line, x, ry, 16, c);
+        snprintf(line, sizeof(line), "%.20s", r->name);
+        DrawText(line, x + 80, ry, 16, c);
+        snprintf(line, sizeof(line), "%d", r->age);
+        DrawText(line, x + 280, ry, 16, c);
+        DrawText(r->contact, x + 330, ry, 16, c);
+        snprintf(line, sizeof(line), "%d", view.list == BACKEND_LIST_CONFIRMED ? r->slot_number : view.top + i + 1);
+        DrawText(line, x + 470, ry, 16, c);
+        if (r->route_from != -1 || r->route_to != -1) {
+            char from[32], to[32];
+            backend_city_name(r->route_from, from, sizeof(from));
+            backend_city_name(r->route_to, to, sizeof(to));
+            snprintf(line, sizeof(line), "%s->%s", from, to);
+            DrawText(line, x + 530, ry, 16, c);
+            snprintf(line, sizeof(line), "Rs %d", r->cost);
+            DrawText(line, x + 710, ry, 16, c);
+        }
+    }
+
+    /* scrollbar */
+    if (view.count > LIST_ROWS) {
+        int track = LIST_H - 50;
+        int thumb = track * LIST_ROWS / view.count;
+        if (thumb < 12) thumb = 12;
+        int ty = LIST_Y + 50 + (int)((long)(track - thumb) * view.top / (view.count - LIST_ROWS));
+        DrawRectangle(LIST_X + LIST_W - 10, LIST_Y + 50, 6, track, (Color){40,40,48,255});
+        DrawRectangle(LIST_X + LIST_W - 10, ty, 6, thumb, GRAY);
+    }
+}
+
+/* ----------------- ACTIONS ----------------- */
+static char output_buf[8192];
+
+/* Runs the action of button k; returns 0 when the program should exit */
+static int run_action(int k) {
+    switch (k) {
+
+    /* -------------------------- BOOK ------------------------- */
+    case ACT_BOOK: {
+        const char *fields[] = {
+            "Name:", "Age:", "Contact:", 
+            "Route From (0=Delhi..5=Bangalore):", 
+            "Route To (0=Delhi..5=Bangalore):"
+        };
+        char outs[5][128];
+        if (modal_input("Book Ticket", fields, 5, outs)) {
+            int id = backend_book(
+                outs[0], atoi(outs[1]), outs[2], 
+                atoi(outs[3]), atoi(outs[4])
+            );
+            if (id == -1)
+                snprintf(output_buf, sizeof(output_buf), "Booking failed. Invalid route or no path.\n");
+            else
+                snprintf(output_buf, sizeof(output_buf), "Booked successfully. ID: %d\n", id);
+
+            backend_save_all();
+            list_reload();
+        }
+        break;
+    }
+
+    /* -------------------------- CANCEL ------------------------- */
+    case ACT_CANCEL: {
+        const char *fields[] = {"Reservation ID:"};
+        char outs[1][128];
+        if (modal_input("Cancel Booking", fields, 1, outs)) {
+            backend_cancel(atoi(outs[0]));
+            snprintf(output_buf, sizeof(output_buf), "Cancellation done.\n");
+            backend_save_all();
+            list_reload();
+        }
+        break;
+    }
+
+    /* -------------------------- MODIFY ------------------------- */
+    case ACT_MODIFY: {
+        const char *fields[] = {"Reservation ID:", "New Name:", "New Age:", "New Contact:"};
+        char outs[4][128];
+        if (modal_input("Modify Details", fields, 4, outs)) {
+            backend_modify(
+                atoi(outs[0]),
+                outs[1],
+                atoi(outs[2]),
+                outs[3]
+            );
+            snprintf(output_buf, sizeof(output_buf), "Modification complete.\n");
+            backend_save_all();
+            list_reload();
+        }
+        break;
+    }
+
+    /* -------------------------- SEARCH ------------------------- */
+    case ACT_SEARCH: {
+        const char *fields[] = {"Reservation ID:"};
+        char outs[1][128];
+        if (modal_input("Search Reservation", fields, 1, outs)) {
+            int res = backend_search(atoi(outs[0]));
+            if (res == 1) snprintf(output_buf, sizeof(output_buf), "Status: CONFIRMED\n");
+            else if (res == 2) snprintf(output_buf, sizeof(output_buf), "Status: WAITLIST\n");
+            else snprintf(output_buf, sizeof(output_buf), "NOT FOUND\n");
+        }
+        break;
+    }
+
+    /* ------------- SHOW CONFIRMED / WAITLIST / SLOT MAP ------------- */
+    case ACT_CONFIRMED:
+        list_show(BACKEND_LIST_CONFIRMED);
+        break;
+    case ACT_WAITLIST:
+        list_show(BACKEND_LIST_WAITLIST);
+        break;
+    case ACT_SLOTMAP:
+        list_show(BACKEND_LIST_SLOTS);
+        break;
+
+    /* --------------------- AVAILABILITY ------------------------- */
+    case ACT_AVAILABILITY:
+        backend_get_availability_text(output_buf, sizeof(output_buf));
+        break;
+
+    /* ----------------------- UNDO LAST -------------------------- */
+    case ACT_UNDO:
+        if (backend_undo()) snprintf(output_buf, sizeof(output_buf), "Undo complete.\n");
+        else snprintf(output_buf, sizeof(output_buf), "Nothing to undo.\n");
+        backend_save_all();
+        list_reload();
+        break;
+
+    /* -------------------------- REDO ---------------------------- */
+    case ACT_REDO:
+        if (backend_redo()) snprintf(output_buf, sizeof(output_buf), "Redo complete.\n");
+        else snprintf(output_buf, sizeof(output_buf), "Nothing to redo.\n");
+        backend_save_all();
+        list_reload();
+        break;
+
+    /* ----------------------- CHANGE SLOTS ----------------------- */
+    case ACT_CHANGE_SLOTS: {
+        const char *fields[] = {"New Total Slots:"};
+        char outs[1][128];
+        if (modal_input("Change Slots", fields, 1, outs)) {
+            backend_change_slots(atoi(outs[0]));
+            snprintf(output_buf, sizeof(output_buf), "Slot count updated.\n");
+            list_reload();
+        }
+        break;
+    }
+
+    /* ----------------------- ASSIGN ROUTE ------------------------ */
+    case ACT_ASSIGN_ROUTE: {
+        const char *fields[] = {
+            "Reservation ID:",
+            "From (0-5):", 
+            "To (0-5):"
+        };
+        char outs[3][128];
+        if (modal_input("Assign Route", fields, 3, outs)) {
+            backend_assign_route(
+                atoi(outs[0]),
+                atoi(outs[1]),
+                atoi(outs[2])
+            );
+            snprintf(output_buf, sizeof(output_buf), "Route assigned (if valid).\n");
+            backend_save_all();
+            list_reload();
+        }
+        break;
+    }
+
+    /* ----------------------- SHORTEST PATH ------------------------ */
+    case ACT_SHORTEST_PATH: {
+        const char *fields[] = {
+            "From (0=Delhi..5=Bangalore):",
+            "To (0=Delhi..5=Bangalore):"
+        };
+        char outs[2][128];
+        if (modal_input("Find Shortest Path", fields, 2, outs)) {
+            backend_get_shortest_path_text(
+                atoi(outs[0]), atoi(outs[1]),
+                output_buf, sizeof(output_buf)
+            );
+        }
+        break;
+    }
+
+    /* ----------------------------- EXIT ---------------------------- */
+    case ACT_EXIT:
+        return 0;
+    }
+    return 1;
+}
+
 int main(void) {
     InitWindow(SCREEN_W, SCREEN_H, "Universal Reservation - Full GUI");
     SetTargetFPS(60);
+    /* frames are drawn on input only: EndDrawing/PollInputEvents sleep until an event arrives */
+    EnableEventWaiting();
 
     backend_init();
+    backend_set_async_persistence(1); /* disk writes happen off the UI thread */
 
-    /* 13 buttons (with shortest path feature) */
-    const char *labels[13] = {
+    /* 14 buttons (with shortest path feature) */
+    const char *labels[ACT_COUNT] = {
         "Book Ticket","Cancel Ticket","Modify","Search",
         "Show Confirmed","Show Waitlist","Slot Map","Availability",
-        "Undo Last","Change Slots","Assign Route","Shortest Path","Exit"
+        "Undo Last","Redo","Change Slots","Assign Route","Shortest Path","Exit"
     };
 
-    Button btns[13];
+    Button btns[ACT_COUNT];
     int i = 0;
 
-    /* Button layout: 4 rows x 4 cols space (we only use 13) */
+    /* Button layout: 4 rows x 4 cols space (we only use 14) */
     for (int r = 0; r < 4; r++) {
         for (int c = 0; c < 4; c++) {
-            if (i >= 13) break;
-            btns[i].rec = (Rectangle){40 + c*210, 60 + r*120, 180, 80};
+            if (i >= ACT_COUNT) break;
+            btns[i].rec = (Rectangle){40 + c*210, 60 + r*58, 180, 48};
             btns[i].label = labels[i];
             i++;
         }
     }
 
-    char output_buf[8192] = {0};
+    list_show(BACKEND_LIST_CONFIRMED);
 
-    while (!WindowShouldClose()) {
-        BeginDrawing();
-        ClearBackground((Color){25,28,34,255});
+    int running = 1, dirty = 1, focused = IsWindowFocused();
+    while (running && !WindowShouldClose()) {
+        if (dirty) {
+            BeginDrawing();
+            ClearBackground((Color){25,28,34,255});
 
-        DrawText("UNIVERSAL RESERVATION SYSTEM", 40, 10, 28, RAYWHITE);
-        DrawText("Enhanced GUI + Shortest Path", 40, 40, 16, LIGHTGRAY);
+            DrawText("UNIVERSAL RESERVATION SYSTEM", 40, 10, 28, RAYWHITE);
+            DrawText("Enhanced GUI + Shortest Path", 40, 40, 16, LIGHTGRAY);
 
-        for (int k = 0; k < 13; k++) DrawButton(btns[k]);
+            for (int k = 0; k < ACT_COUNT; k++) DrawButton(btns[k]);
 
-        /* Output panel */
-        DrawRectangle(40, SCREEN_H-130, SCREEN_W-80, 110, (Color){14,14,18,255});
-        DrawRectangleLines(40, SCREEN_H-130, SCREEN_W-80, 110, DARKGRAY);
-        DrawText("Output:", 50, SCREEN_H-120, 18, LIGHTGRAY);
+            list_draw();
 
-        DrawTextPro(GetFontDefault(), output_buf, 
-                    (Vector2){50, SCREEN_H-95}, 
-                    (Vector2){0,0}, 0, 16, 2, LIGHTGRAY);
+            /* Output panel */
+            DrawRectangle(40, SCREEN_H-130, SCREEN_W-80, 110, (Color){14,14,18,255});
+            DrawRectangleLines(40, SCREEN_H-130, SCREEN_W-80, 110, DARKGRAY);
+            DrawText("Output:", 50, SCREEN_H-120, 18, LIGHTGRAY);
 
-        EndDrawing();
+            DrawTextPro(GetFontDefault(), output_buf, 
+                        (Vector2){50, SCREEN_H-95}, 
+                        (Vector2){0,0}, 0, 16, 2, LIGHTGRAY);
+
+            EndDrawing();
+            dirty = 0;
+        } else {
+            PollInputEvents(); /* nothing changed: keep the last frame and wait for input */
+        }
+
+        /* the window may have lost its contents */
+        if (IsWindowResized() || IsWindowFocused() != focused) {
+            focused = IsWindowFocused();
+            dirty = 1;
+        }
+
+        /* Scrolling */
+        float wheel = GetMouseWheelMove();
+        if (wheel > 0) dirty |= list_scroll(-3);
+        if (wheel < 0) dirty |= list_scroll(3);
+        if (IsKeyPressed(KEY_UP)) dirty |= list_scroll(-1);
+        if (IsKeyPressed(KEY_DOWN)) dirty |= list_scroll(1);
+        if (IsKeyPressed(KEY_PAGE_UP)) dirty |= list_scroll(-LIST_ROWS);
+        if (IsKeyPressed(KEY_PAGE_DOWN)) dirty |= list_scroll(LIST_ROWS);
+        if (IsKeyPressed(KEY_HOME)) dirty |= list_scroll(-view.count);
+        if (IsKeyPressed(KEY_END)) dirty |= list_scroll(view.count);
 
         /* Check button clicks */
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
             Vector2 m = GetMousePosition();
-
-            for (int k = 0; k < 13; k++) {
+            for (int k = 0; k < ACT_COUNT; k++) {
                 if (CheckCollisionPointRec(m, btns[k].rec)) {
-
-                    /* -------------------------- BOOK ------------------------- */
-                    if (strcmp(btns[k].label, "Book Ticket") == 0) {
-                        const char *fields[] = {
-                            "Name:", "Age:", "Contact:", 
-                            "Route From (0=Delhi..5=Bangalore):", 
-                            "Route To (0=Delhi..5=Bangalore):"
-                        };
-                        char outs[5][128];
-                        if (modal_input("Book Ticket", fields, 5, outs)) {
-                            int id = backend_book(
-                                outs[0], atoi(outs[1]), outs[2], 
-                                atoi(outs[3]), atoi(outs[4])
-                            );
-                            if (id == -1)
-                                snprintf(output_buf, sizeof(output_buf), "Booking failed. Invalid route or no path.\n");
-                            else
-                                snprintf(output_buf, sizeof(output_buf), "Booked successfully. ID: %d\n", id);
-
-                            backend_save_all();
-                        }
-                    }
-
-                    /* -------------------------- CANCEL ------------------------- */
-                    else if (strcmp(btns[k].label, "Cancel Ticket") == 0) {
-                        const char *fields[] = {"Reservation ID:"};
-                        char outs[1][128];
-                        if (modal_input("Cancel Booking", fields, 1, outs)) {
-                            backend_cancel(atoi(outs[0]));
-                            snprintf(output_buf, sizeof(output_buf), "Cancellation done.\n");
-                            backend_save_all();
-                        }
-                    }
-
-                    /* -------------------------- MODIFY ------------------------- */
-                    else if (strcmp(btns[k].label, "Modify") == 0) {
-                        const char *fields[] = {"Reservation ID:", "New Name:", "New Age:", "New Contact:"};
-                        char outs[4][128];
-                        if (modal_input("Modify Details", fields, 4, outs)) {
-                            backend_modify(
-                                atoi(outs[0]),
-                                outs[1],
-                                atoi(outs[2]),
-                                outs[3]
-                            );
-                            snprintf(output_buf, sizeof(output_buf), "Modification complete.\n");
-                            backend_save_all();
-                        }
-                    }
-
-                    /* -------------------------- SEARCH ------------------------- */
-                    else if (strcmp(btns[k].label, "Search") == 0) {
-                        const char *fields[] = {"Reservation ID:"};
-                        char outs[1][128];
-                        if (modal_input("Search Reservation", fields, 1, outs)) {
-                            int res = backend_search(atoi(outs[0]));
-                            if (res == 1) snprintf(output_buf, sizeof(output_buf), "Status: CONFIRMED\n");
-                            else if (res == 2) snprintf(output_buf, sizeof(output_buf), "Status: WAITLIST\n");
-                            else snprintf(output_buf, sizeof(output_buf), "NOT FOUND\n");
-                        }
-                    }
-
-                    /* --------------------- SHOW CONFIRMED ---------------------- */
-                    else if (strcmp(btns[k].label, "Show Confirmed") == 0) {
-                        backend_get_confirmed_text(output_buf, sizeof(output_buf));
-                    }
-
-                    /* --------------------- SHOW WAITLIST ------------------------- */
-                    else if (strcmp(btns[k].label, "Show Waitlist") == 0) {
-                        backend_get_waitlist_text(output_buf, sizeof(output_buf));
-                    }
-
-                    /* --------------------- SLOT MAP ---------------------------- */
-                    else if (strcmp(btns[k].label, "Slot Map") == 0) {
-                        backend_get_slotmap_text(output_buf, sizeof(output_buf));
-                    }
-
-                    /* --------------------- AVAILABILITY ------------------------- */
-                    else if (strcmp(btns[k].label, "Availability") == 0) {
-                        backend_get_availability_text(output_buf, sizeof(output_buf));
-                    }
-
-                    /* ----------------------- UNDO LAST -------------------------- */
-                    else if (strcmp(btns[k].label, "Undo Last") == 0) {
-                        backend_undo();
-                        snprintf(output_buf, sizeof(output_buf), "Undo complete.\n");
-                        backend_save_all();
-                    }
-
-                    /* ----------------------- CHANGE SLOTS ----------------------- */
-                    else if (strcmp(btns[k].label, "Change Slots") == 0) {
-                        const char *fields[] = {"New Total Slots:"};
-                        char outs[1][128];
-                        if (modal_input("Change Slots", fields, 1, outs)) {
-                            backend_change_slots(atoi(outs[0]));
-                            snprintf(output_buf, sizeof(output_buf), "Slot count updated.\n");
-                        }
-                    }
-
-                    /* ----------------------- ASSIGN ROUTE ------------------------ */
-                    else if (strcmp(btns[k].label, "Assign Route") == 0) {
-                        const char *fields[] = {
-                            "Reservation ID:",
-                            "From (0-5):", 
-                            "To (0-5):"
-                        };
-                        char outs[3][128];
-                        if (modal_input("Assign Route", fields, 3, outs)) {
-                            backend_assign_route(
-                                atoi(outs[0]),
-                                atoi(outs[1]),
-                                atoi(outs[2])
-                            );
-                            snprintf(output_buf, sizeof(output_buf), "Route assigned (if valid).\n");
-                            backend_save_all();
-                        }
-                    }
-
-                    /* ----------------------- SHORTEST PATH ------------------------ */
-                    else if (strcmp(btns[k].label, "Shortest Path") == 0) {
-                        const char *fields[] = {
-                            "From (0=Delhi..5=Bangalore):",
-                            "To (0=Delhi..5=Bangalore):"
-                        };
-                        char outs[2][128];
-                        if (modal_input("Find Shortest Path", fields, 2, outs)) {
-                            char spbuf[1024];
-                            int res = backend_get_shortest_path_text(
-                                atoi(outs[0]), atoi(outs[1]),
-                                spbuf, sizeof(spbuf)
-                            );
-                            snprintf(output_buf, sizeof(output_buf), "%s", spbuf);
-                        }
-                    }
-
-                    /* ----------------------------- EXIT ---------------------------- */
-                    else if (strcmp(btns[k].label, "Exit") == 0) {
-                        backend_save_all();
-                        CloseWindow();
-                        return 0;
-                    }
+                    running = run_action(k);
+                    dirty = 1;
+                    break;
                 }
             }
         }
     }
 
+    free(view.marks);
     backend_save_all();
+    backend_flush();
     CloseWindow();
     return 0;
 }
@@ -0,0 +1,462 @@
+/* headless.c
+   Headless driver for Universal Reservation System (no raylib, Linux/POSIX).
+   Reads one command per line from stdin, or from every client of a Unix
+   domain socket, and answers each with one line:
+       OK [values]      or      ERR <reason>
+   Listing commands answer OK, then the text lines, then a line with a single ".".
+   Replies are buffered and only written once every complete command already
+   received has been run, so clients can pipeline requests.
+
+   Commands:
+       BOOK <from> <to> <age> <contact> <name...>   -> OK <reservation id>
+       GROUP <from> <to> <contact> <age> <name> [<age> <name> ...]
+                                                     -> OK CONFIRMED|WAITLISTED <ids...>
+       CANCEL <id>
+       MODIFY <id> <age|0> <contact|-> <name...|->   (0 / - keep the old value)
+       SEARCH <id>                                   -> OK NONE|CONFIRMED|WAITLISTED
+       FIND CONTACT <contact> | FIND NAME <prefix...> | FIND ROUTE <from> <to>
+                                                     -> OK <ids...> (name prefix ignores case;
+                                                        OK+ if more than the first 1000 matched;
+                                                        a clipped ROUTE reply holds any 1000 of
+                                                        them, ROUTESTATS gives the full count)
+       ROUTESTATS <from> <to>                        -> OK <confirmed> <waitlisted> <revenue>
+       ASSIGN <id> <from> <to>
+       ROUTE <from> <to>                             -> OK <path, distance, cost and alternatives>
+       UNDO | REDO                                   (ERR if there is no step to take)
+       SLOTS <n>
+       LEGCAP <from> <to> <seats|-1>                 (-1 = unlimited)
+       AVAIL                                         -> OK <total> <booked> <available>
+       CONFIRMED | WAITLIST | SLOTMAP | LEGS | STATS (listings; the first three are
+                                                     streamed, so they are never truncated)
+       SAVE | COMMIT | CHECKPOINT | FLUSH | EXPORT
+       QUIT
+
+   Usage: headless [-C dir] [-s socket_path] [-a] [-f none|batch|always]
+       -C  data directory (snapshot.bin, journal.bin, CSV files)
+       -s  serve a Unix domain socket, one thread per client, instead of stdin
+       -a  background writer thread for journal and snapshot writes
+       -f  journal fsync policy
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "backend.h"
+
+#define IN_BUF (64 * 1024)        /* longest command line accepted */
+#define OUT_FLUSH (64 * 1024)     /* pending reply bytes that force a write */
+#define TEXT_BUF (1024 * 1024)    /* listing commands */
+#define GROUP_MAX 64              /* passengers per GROUP command */
+#define FIND_MAX 1000             /* ids per FIND reply */
+
+struct Conn {
+    int in_fd;
+    int out_fd;
+    char in[IN_BUF];
+    size_t in_len;
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+    char *text;                   /* scratch for the text getters */
+    int quit;
+};
+
+static volatile sig_atomic_t stopping = 0;
+static int listen_fd = -1;
+
+/* ----------------- OUTPUT ----------------- */
+static int out_flush(struct Conn *c) {
+    size_t done = 0;
+    while (done < c->out_len) {
+        ssize_t n = write(c->out_fd, c->out + done, c->out_len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) { c->quit = 1; break; }
+        done += (size_t)n;
+    }
+    c->out_len = 0;
+    return c->quit ? -1 : 0;
+}
+
+static void out_write(struct Conn *c, const char *s, size_t len) {
+    if (c->out_len + len > c->out_cap) {
+        size_t cap = c->out_cap ? c->out_cap : 4096;
+        while (cap < c->out_len + len) cap *= 2;
+        char *out = realloc(c->out, cap);
+        if (!out) { c->quit = 1; return; }
+        c->out = out;
+        c->out_cap = cap;
+    }
+    memcpy(c->out + c->out_len, s, len);
+    c->out_len += len;
+}
+
+static void reply(struct Conn *c, const char *fmt, ...) {
+    char line[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if (n > (int)sizeof(line) - 2) n = sizeof(line) - 2;
+    line[n++] = '\n';
+    out_write(c, line, (size_t)n);
+}
+
+/* Multi-line answer: OK, the text (each line as is), then "." */
+static void reply_block(struct Conn *c, const char *text) {
+    reply(c, "OK");
+    size_t len = strlen(text);
+    out_write(c, text, len);
+    if (len > 0 && text[len - 1] != '\n') out_write(c, "\n", 1);
+    out_write(c, ".\n", 2);
+}
+
+/* backend_writer for streamed listings: queued like any reply, written out as it piles up */
+static int out_stream(void *ctx, const char *text, int len) {
+    struct Conn *c = ctx;
+    out_write(c, text, (size_t)len);
+    if (c->out_len >= OUT_FLUSH) out_flush(c);
+    return c->quit ? -1 : 0;
+}
+
+/* Multi-line answer streamed from a backend listing, in bounded memory */
+static void reply_list(struct Conn *c, int list) {
+    reply(c, "OK");
+    backend_write_list(list, out_stream, c);
+    out_write(c, ".\n", 2);
+}
+
+/* ----------------- COMMANDS ----------------- */
+static int parse_int(char **p, int *out) {
+    char *end;
+    long v = strtol(*p, &end, 10);
+    if (end == *p || (*end && *end != ' ' && *end != '\t')) return -1;
+    *out = (int)v;
+    *p = end;
+    while (**p == ' ' || **p == '\t') (*p)++;
+    return 0;
+}
+
+/* Next space-separated word, NUL-terminated in place */
+static char *parse_word(char **p) {
+    char *w = *p;
+    if (!*w) return NULL;
+    while (**p && **p != ' ' && **p != '\t') (*p)++;
+    if (**p) *(*p)++ = '\0';
+    while (**p == ' ' || **p == '\t') (*p)++;
+    return w;
+}
+
+static void run_command(struct Conn *c, char *line) {
+    char *p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    char *cmd = parse_word(&p);
+    if (!cmd) return; /* blank line */
+    int id, a, b;
+
+    if (strcmp(cmd, "BOOK") == 0) {
+        int from, to, age;
+        char *contact;
+        if (parse_int(&p, &from) || parse_int(&p, &to) || parse_int(&p, &age) || !(contact = parse_word(&p)) || !*p) {
+            reply(c, "ERR usage: BOOK <from> <to> <age> <contact> <name>");
+            return;
+        }
+        int res = backend_book(p, age, contact, from, to);
+        if (res < 0) reply(c, "ERR no route");
+        else reply(c, "OK %d", res);
+    } else if (strcmp(cmd, "GROUP") == 0) {
+        int from, to, k = 0;
+        char *contact;
+        const char *names[GROUP_MAX];
+        int ages[GROUP_MAX], ids[GROUP_MAX];
+        if (parse_int(&p, &from) || parse_int(&p, &to) || !(contact = parse_word(&p))) k = -1;
+        while (k >= 0 && *p) {
+            if (k == GROUP_MAX || parse_int(&p, &ages[k]) || !(names[k] = parse_word(&p))) k = -1;
+            else k++;
+        }
+        if (k < 1) {
+            reply(c, "ERR usage: GROUP <from> <to> <contact> <age> <name> [<age> <name> ...] (at most %d)", GROUP_MAX);
+            return;
+        }
+        int res = backend_book_group(k, names, ages, contact, from, to, ids);
+        if (res < 0) { reply(c, "ERR no route"); return; }
+        int pos = snprintf(c->text, TEXT_BUF, "OK %s", res == 1 ? "CONFIRMED" : "WAITLISTED");
+        for (int i = 0; i < k; i++) pos += snprintf(c->text + pos, TEXT_BUF - pos, " %d", ids[i]);
+        reply(c, "%s", c->text);
+    } else if (strcmp(cmd, "CANCEL") == 0) {
+        if (parse_int(&p, &id)) { reply(c, "ERR usage: CANCEL <id>"); return; }
+        backend_cancel(id);
+        reply(c, "OK");
+    } else if (strcmp(cmd, "MODIFY") == 0) {
+        int age;
+        char *contact;
+        if (parse_int(&p, &id) || parse_int(&p, &age) || !(contact = parse_word(&p))) {
+            reply(c, "ERR usage: MODIFY <id> <age|0> <contact|-> <name|->");
+            return;
+        }
+        backend_modify(id, strcmp(p, "-") == 0 ? "" : p, age, strcmp(contact, "-") == 0 ? "" : contact);
+        reply(c, "OK");
+    } else if (strcmp(cmd, "SEARCH") == 0) {
+        if (parse_int(&p, &id)) { reply(c, "ERR usage: SEARCH <id>"); return; }
+        int res = backend_search(id);
+        reply(c, "OK %s", res == 1 ? "CONFIRMED" : res == 2 ? "WAITLISTED" : "NONE");
+    } else if (strcmp(cmd, "FIND") == 0) {
+        /* one id past FIND_MAX tells whether the reply leaves matches out */
+        int ids[FIND_MAX + 1];
+        char *kind = parse_word(&p);
+        int n = -2;
+        if (kind && strcmp(kind, "CONTACT") == 0 && *p) n = backend_find_by_contact(parse_word(&p), ids, FIND_MAX + 1);
+        else if (kind && strcmp(kind, "NAME") == 0) n = backend_find_by_name_prefix(p, ids, FIND_MAX + 1);
+        else if (kind && strcmp(kind, "ROUTE") == 0 && !parse_int(&p, &a) && !parse_int(&p, &b)) n = backend_find_by_route(a, b, ids, FIND_MAX + 1);
+        if (n == -2) { reply(c, "ERR usage: FIND CONTACT <contact> | FIND NAME <prefix> | FIND ROUTE <from> <to>"); return; }
+        if (n < 0) { reply(c, "ERR out of memory"); return; }
+        int pos = 0, i;
+        for (i = 0; i < n && i < FIND_MAX && pos < TEXT_BUF - 16; i++) pos += snprintf(c->text + pos, TEXT_BUF - pos, " %d", ids[i]);
+        /* written as is: reply() would cut the line mid-id */
+        out_write(c, i < n ? "OK+" : "OK", i < n ? 3 : 2);
+        c->text[pos++] = '\n';
+        out_write(c, c->text, pos);
+    } else if (strcmp(cmd, "ROUTESTATS") == 0) {
+        struct backend_route_stats s;
+        if (parse_int(&p, &a) || parse_int(&p, &b)) { reply(c, "ERR usage: ROUTESTATS <from> <to>"); return; }
+        backend_get_route_stats(a, b, &s);
+        reply(c, "OK %d %d %lld", s.confirmed, s.waitlisted, s.revenue);
+    } else if (strcmp(cmd, "ASSIGN") == 0) {
+        if (parse_int(&p, &id) || parse_int(&p, &a) || parse_int(&p, &b)) {
+            reply(c, "ERR usage: ASSIGN <id> <from> <to>");
+            return;
+        }
+        backend_assign_route(id, a, b);
+        reply(c, "OK");
+    } else if (strcmp(cmd, "ROUTE") == 0) {
+        if (parse_int(&p, &a) || parse_int(&p, &b)) { reply(c, "ERR usage: ROUTE <from> <to>"); return; }
+        int res = backend_get_shortest_path_text(a, b, c->text, TEXT_BUF);
+        /* one line: path | Distance: d | Cost: c */
+        size_t len = strlen(c->text);
+        while (len > 0 && c->text[len - 1] == '\n') c->text[--len] = '\0';
+        for (char *q = c->text; *q; q++) if (*q == '\n') *q = '|';
+        /* written as is: options on a large graph run past reply()'s line */
+        out_write(c, res == 0 ? "OK " : "ERR ", res == 0 ? 3 : 4);
+        c->text[len++] = '\n';
+        out_write(c, c->text, len);
+    } else if (strcmp(cmd, "UNDO") == 0) {
+        if (backend_undo()) reply(c, "OK");
+        else reply(c, "ERR nothing to undo");
+    } else if (strcmp(cmd, "REDO") == 0) {
+        if (backend_redo()) reply(c, "OK");
+        else reply(c, "ERR nothing to redo");
+    } else if (strcmp(cmd, "SLOTS") == 0) {
+        if (parse_int(&p, &a)) { reply(c, "ERR usage: SLOTS <n>"); return; }
+        backend_change_slots(a);
+        reply(c, "OK");
+    } else if (strcmp(cmd, "LEGCAP") == 0) {
+        int seats;
+        if (parse_int(&p, &a) || parse_int(&p, &b) || parse_int(&p, &seats)) {
+            reply(c, "ERR usage: LEGCAP <from> <to> <seats|-1>");
+            return;
+        }
+        if (backend_set_leg_capacity(a, b, seats) != 0) reply(c, "ERR no such leg or seats below bookings");
+        else reply(c, "OK");
+    } else if (strcmp(cmd, "AVAIL") == 0) {
+        int total = 0, booked = 0, avail = 0;
+        backend_get_availability_text(c->text, TEXT_BUF);
+        sscanf(c->text, "Total: %d\nBooked: %d\nAvailable: %d", &total, &booked, &avail);
+        reply(c, "OK %d %d %d", total, booked, avail);
+    } else if (strcmp(cmd, "CONFIRMED") == 0) {
+        reply_list(c, BACKEND_LIST_CONFIRMED);
+    } else if (strcmp(cmd, "WAITLIST") == 0) {
+        reply_list(c, BACKEND_LIST_WAITLIST);
+    } else if (strcmp(cmd, "SLOTMAP") == 0) {
+        reply_list(c, BACKEND_LIST_SLOTS);
+    } else if (strcmp(cmd, "LEGS") == 0) {
+        backend_get_legs_text(c->text, TEXT_BUF);
+        reply_block(c, c->text);
+    } else if (strcmp(cmd, "STATS") == 0) {
+        backend_get_stats_text(c->text, TEXT_BUF);
+        reply_block(c, c->text);
+    } else if (strcmp(cmd, "SAVE") == 0) {
+        backend_save_all();
+        reply(c, "OK");
+    } else if (strcmp(cmd, "COMMIT") == 0) {
+        backend_commit();
+        reply(c, "OK");
+    } else if (strcmp(cmd, "CHECKPOINT") == 0) {
+        backend_checkpoint();
+        reply(c, "OK");
+    } else if (strcmp(cmd, "FLUSH") == 0) {
+        if (backend_flush() != 0) reply(c, "ERR write failed");
+        else reply(c, "OK");
+    } else if (strcmp(cmd, "EXPORT") == 0) {
+        if (backend_export_csv() != 0) reply(c, "ERR write failed");
+        else reply(c, "OK");
+    } else if (strcmp(cmd, "QUIT") == 0) {
+        reply(c, "OK");
+        c->quit = 1;
+    } else {
+        reply(c, "ERR unknown command %s", cmd);
+    }
+}
+
+/* ----------------- CONNECTION LOOP ----------------- */
+/* Runs every complete line in the input buffer; replies are flushed only when
+   the next read would block on an empty buffer */
+static void serve(struct Conn *c) {
+    size_t skip = 0; /* bytes of an overlong line still to discard */
+    while (!c->quit) {
+        ssize_t n = read(c->in_fd, c->in + c->in_len, IN_BUF - c->in_len);
+        if (n < 0 && errno == EINTR) {
+            if (stopping) break;
+            continue;
+        }
+        if (n <= 0) break;
+        c->in_len += (size_t)n;
+
+        size_t start = 0;
+        for (size_t i = c->in_len - (size_t)n; i < c->in_len && !c->quit; i++) {
+            if (c->in[i] != '\n') continue;
+            c->in[i] = '\0';
+            if (i > start && c->in[i - 1] == '\r') c->in[i - 1] = '\0';
+            if (skip) skip = 0;
+            else run_command(c, c->in + start);
+            start = i + 1;
+            if (c->out_len >= OUT_FLUSH) out_flush(c);
+        }
+        memmove(c->in, c->in + start, c->in_len - start);
+        c->in_len -= start;
+        if (c->in_len == IN_BUF) {
+            /* no newline in a full buffer: drop the line */
+            reply(c, "ERR line too long");
+            c->in_len = 0;
+            skip = 1;
+        }
+        if (c->out_len > 0 && out_flush(c) != 0) break;
+    }
+    if (c->out_len > 0) out_flush(c);
+}
+
+static struct Conn *conn_new(int in_fd, int out_fd) {
+    struct Conn *c = calloc(1, sizeof(struct Conn));
+    if (!c) return NULL;
+    c->text = malloc(TEXT_BUF);
+    if (!c->text) { free(c); return NULL; }
+    c->in_fd = in_fd;
+    c->out_fd = out_fd;
+    return c;
+}
+
+static void conn_free(struct Conn *c) {
+    free(c->out);
+    free(c->text);
+    free(c);
+}
+
+static void *client_main(void *arg) {
+    struct Conn *c = arg;
+    serve(c);
+    close(c->in_fd);
+    conn_free(c);
+    return NULL;
+}
+
+/* ----------------- SOCKET SERVER ----------------- */
+static void on_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static int serve_socket(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return -1;
+    }
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) { perror("socket"); return -1; }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 64) != 0) {
+        perror(path);
+        close(listen_fd);
+        return -1;
+    }
+
+    /* clients are served concurrently; the backend API is thread-safe */
+    while (!stopping) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            break;
+        }
+        struct Conn *c = conn_new(fd, fd);
+        pthread_t th;
+        if (!c || pthread_create(&th, NULL, client_main, c) != 0) {
+            if (c) conn_free(c);
+            close(fd);
+            continue;
+        }
+        pthread_detach(th);
+    }
+    close(listen_fd);
+    unlink(path);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *dir = NULL, *sock = NULL;
+    int async = 0, policy = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "C:s:af:")) != -1) {
+        switch (opt) {
+        case 'C': dir = optarg; break;
+        case 's': sock = optarg; break;
+        case 'a': async = 1; break;
+        case 'f':
+            if (strcmp(optarg, "none") == 0) policy = BACKEND_FSYNC_NONE;
+            else if (strcmp(optarg, "batch") == 0) policy = BACKEND_FSYNC_BATCH;
+            else if (strcmp(optarg, "always") == 0) policy = BACKEND_FSYNC_ALWAYS;
+            else { fprintf(stderr, "unknown fsync policy %s\n", optarg); return 2; }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-C dir] [-s socket_path] [-a] [-f none|batch|always]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (dir && chdir(dir) != 0) { perror(dir); return 1; }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal; /* no SA_RESTART: accept/read return EINTR */
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    backend_init();
+    if (policy >= 0) backend_set_fsync_policy(policy);
+    if (async) backend_set_async_persistence(1);
+
+    int rc = 0;
+    if (sock) {
+        rc = serve_socket(sock) == 0 ? 0 : 1;
+    } else {
+        struct Conn *c = conn_new(0, 1);
+        if (!c) return 1;
+        serve(c);
+        conn_free(c);
+    }
+
+    backend_save_all();
+    if (backend_flush() != 0) rc = 1;
+    return rc;
+}